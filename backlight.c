@@ -0,0 +1,131 @@
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include "backlight.h"
+
+// Timer4 duty cycle for each brightness level, gamma corrected (2.2) so the
+// fade looks even. The LCD LED is lit when the output is low so full
+// brightness is a duty cycle of 0.
+static const uint16_t backlight_gamma[BACKLIGHT_LEVELS] PROGMEM =
+{
+    1023, 1023, 1022, 1022, 1021, 1019, 1017, 1015,
+    1012, 1009, 1005, 1001,  996,  991,  986,  979,
+     973,  966,  958,  950,  941,  932,  922,  912,
+     901,  889,  877,  864,  851,  837,  823,  808,
+     793,  776,  760,  742,  724,  706,  687,  667,
+     646,  625,  604,  581,  559,  535,  511,  486,
+     461,  434,  408,  380,  352,  324,  294,  264,
+     234,  202,  170,  137,  104,   70,   35,    0
+};
+
+// Current level and fade step in 1/256ths of a level. The step is rounded
+// towards zero, what it leaves out (remainder/duration of a 1/256th per
+// tick) is added back a 1/256th at a time as error builds up, so a fade
+// takes exactly the duration asked for.
+static volatile uint16_t backlight_position;
+static volatile int16_t backlight_step;
+static volatile uint16_t backlight_target;
+static volatile int8_t backlight_direction;
+static volatile uint16_t backlight_remainder;
+static volatile uint16_t backlight_error;
+static volatile uint16_t backlight_duration;
+
+// Longest fade, so that the error never overflows.
+#define BACKLIGHT_DURATION_MAX 0x7FFF
+
+/**
+*   Function for writing a brightness level to the Timer4 compare register.
+*/
+static void backlight_write(uint8_t level)
+{
+    uint16_t duty_cycle = pgm_read_word(&backlight_gamma[level]);
+    TC4H = duty_cycle >> 8;
+    OCR4A = duty_cycle & 0xff;
+}
+
+/**
+*   Function for setting the starting brightness and enabling the Timer4
+*   overflow interrupt that steps the fades, Timer4 itself is set up for
+*   PWM in teensy_init.
+*
+*   Parameters:
+*           level: The brightness level to start at.
+*/
+void backlight_init(uint8_t level)
+{
+    backlight_position = backlight_target = (uint16_t)level << 8;
+    backlight_step = 0;
+    backlight_write(level);
+    TIMSK4 |= (1<<TOIE4);
+}
+
+/**
+*   Function for starting a fade, the fade is then carried out entirely by
+*   the Timer4 overflow interrupt.
+*
+*   Parameters:
+*           level: The brightness level to fade to.
+*           duration: The length of the fade in Timer4 overflows, see
+*                     BACKLIGHT_TICKS.
+*/
+void backlight_fade(uint8_t level, uint16_t duration)
+{
+    if(level > BACKLIGHT_FULL)
+        level = BACKLIGHT_FULL;
+    if(duration == 0)
+        duration = 1;
+    if(duration > BACKLIGHT_DURATION_MAX)
+        duration = BACKLIGHT_DURATION_MAX;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        backlight_target = (uint16_t)level << 8;
+        int16_t distance = (int16_t)(backlight_target - backlight_position);
+        backlight_direction = distance < 0 ? -1 : 1;
+        backlight_step = distance / (int16_t)duration;
+        backlight_remainder = (distance < 0 ? -distance : distance) % duration;
+        backlight_error = 0;
+        backlight_duration = duration;
+    }
+}
+
+/**
+*   Returns non zero once the backlight has reached the last fade target.
+*/
+uint8_t backlight_done()
+{
+    uint8_t done;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        done = backlight_position == backlight_target;
+    }
+    return done;
+}
+
+ISR(TIMER4_OVF_vect)
+{
+    if(backlight_position == backlight_target)
+        return;
+
+    int16_t step = backlight_step;
+    backlight_error += backlight_remainder;
+    if(backlight_error >= backlight_duration)
+    {
+        backlight_error -= backlight_duration;
+        step += backlight_direction;
+    }
+
+    uint16_t remaining = backlight_direction > 0 ?
+        backlight_target - backlight_position :
+        backlight_position - backlight_target;
+    uint16_t size = step > 0 ? step : -step;
+
+    if(size >= remaining)
+        backlight_position = backlight_target;
+    else
+        backlight_position += step;
+
+    backlight_write(backlight_position >> 8);
+}
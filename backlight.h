@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+// Brightness levels, 0 is the backlight off and BACKLIGHT_FULL fully lit.
+#define BACKLIGHT_LEVELS 64
+#define BACKLIGHT_OFF 0
+#define BACKLIGHT_FULL (BACKLIGHT_LEVELS-1)
+
+// Timer4 overflows approx 122 times per second (8MHz / 64 / 1024).
+#define BACKLIGHT_TICKS(seconds) ((uint16_t)((seconds) * 8000000.0 / (64.0 * 1024.0)))
+
+void backlight_init(uint8_t level);
+void backlight_fade(uint8_t level, uint16_t duration);
+uint8_t backlight_done(void);
@@ -0,0 +1,181 @@
+#ifdef BENCHMARK
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "avr_mcu_section.h"
+#include "bench.h"
+
+// Tells simavr the part and clock, and to print each line written to GPIOR0
+// on its console since there is no USB host in the simulator.
+AVR_MCU(F_CPU, "atmega32u4");
+AVR_MCU_SIMAVR_CONSOLE(&GPIOR0);
+
+// Port B inputs held down, ORed into what the game reads from PINB.
+volatile uint8_t bench_pinb=0;
+
+// Bytes fed to the game in place of the USB port.
+static const uint8_t * bench_input;
+static uint8_t bench_input_left=0;
+
+static void bench_print(const char * text)
+{
+    while(*text)
+    {
+        GPIOR0 = *text++;
+    }
+}
+
+static void bench_print_uint(uint32_t value)
+{
+    char digits[11];
+    uint8_t i = sizeof(digits);
+
+    digits[--i] = '\0';
+    do
+    {
+        digits[--i] = '0' + value % 10;
+        value /= 10;
+    } while(value);
+    bench_print(&digits[i]);
+}
+
+/**
+*   Function for printing the result of a scene as one line, read by
+*   tools/bench_check. Scene specific metrics can follow with bench_metric
+*   before bench_end finishes the line.
+*
+*   Parameters:
+*           scene: The name of the scene.
+*           frames: The number of frames in the scene.
+*           cycles: CPU cycles taken by the whole scene.
+*           isr_max: The longest game tick interrupt in cycles.
+*           stack: The most stack used in bytes.
+*/
+void bench_report(const char * scene, uint16_t frames, uint32_t cycles, uint16_t isr_max, uint16_t stack)
+{
+    bench_print("bench scene=");
+    bench_print(scene);
+    bench_print(" frames=");
+    bench_print_uint(frames);
+    bench_print(" cycles_per_frame=");
+    bench_print_uint(cycles / frames);
+    bench_print(" isr_max=");
+    bench_print_uint(isr_max);
+    bench_print(" stack=");
+    bench_print_uint(stack);
+}
+
+/**
+*   Function for adding a metric to the line started by bench_report.
+*
+*   Parameters:
+*           name: The metric, lower case and underscores only.
+*           value: Its value for the scene.
+*/
+void bench_metric(const char * name, uint32_t value)
+{
+    bench_print(" ");
+    bench_print(name);
+    bench_print("=");
+    bench_print_uint(value);
+}
+
+/**
+*   Function for finishing the line started by bench_report.
+*/
+void bench_end()
+{
+    bench_print("\n");
+}
+
+/**
+*   Function for printing the result of a scene that times a single
+*   operation rather than whole frames.
+*
+*   Parameters:
+*           scene: The name of the scene.
+*           ops: The number of times the operation ran.
+*           cycles: CPU cycles taken by all of them.
+*/
+void bench_report_ops(const char * scene, uint16_t ops, uint32_t cycles)
+{
+    bench_print("bench scene=");
+    bench_print(scene);
+    bench_print(" ops=");
+    bench_print_uint(ops);
+    bench_print(" cycles_per_op=");
+    bench_print_uint(cycles / ops);
+    bench_print("\n");
+}
+
+/**
+*   Function for ending the run, simavr exits when the CPU sleeps with
+*   interrupts off.
+*/
+static void bench_halt()
+{
+    cli();
+    sleep_enable();
+    for(;;)
+    {
+        sleep_cpu();
+    }
+}
+
+/**
+*   Function for stopping once every scene has run. The last line tells
+*   bench_check that the run was not cut short.
+*/
+void bench_stop()
+{
+    bench_print("bench done\n");
+    bench_halt();
+}
+
+/**
+*   Function for stopping when a scene cannot be set up, the run is left
+*   without its "bench done" line so bench_check fails it.
+*
+*   Parameters:
+*           why: What went wrong, printed for the person running it.
+*/
+void bench_fail(const char * why)
+{
+    bench_print("bench failed: ");
+    bench_print(why);
+    bench_print("\n");
+    bench_halt();
+}
+
+/**
+*   Function for queueing bytes to be read as if they came from the serial
+*   console, the bytes must stay put until they have all been read.
+*/
+void bench_feed(const uint8_t * bytes, uint8_t length)
+{
+    bench_input = bytes;
+    bench_input_left = length;
+}
+
+/**
+*   Returns the next byte fed, -1 if there are none like usb_serial_getchar.
+*/
+int16_t bench_getchar()
+{
+    if(!bench_input_left)
+        return -1;
+    bench_input_left--;
+    return *bench_input++;
+}
+
+/**
+*   Returns the number of bytes fed that have not been read yet.
+*/
+uint8_t bench_available()
+{
+    return bench_input_left;
+}
+
+#endif
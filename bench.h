@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+// The benchmark scenes only exist when built with "make BENCHMARK=1", which
+// is meant to be run in simavr rather than on a Teensy (see "make bench" in
+// the makefile).
+#ifdef BENCHMARK
+extern volatile uint8_t bench_pinb;
+
+void bench_report(const char * scene, uint16_t frames, uint32_t cycles, uint16_t isr_max, uint16_t stack);
+void bench_metric(const char * name, uint32_t value);
+void bench_end(void);
+void bench_report_ops(const char * scene, uint16_t ops, uint32_t cycles);
+void bench_stop(void);
+void bench_fail(const char * why);
+void bench_feed(const uint8_t * bytes, uint8_t length);
+int16_t bench_getchar(void);
+uint8_t bench_available(void);
+#endif
@@ -0,0 +1,208 @@
+#include <stdint.h>
+#include "collide.h"
+
+/**
+*   Function for clipping the part of a path that lies within one axis of
+*   the box, the slab test.
+*
+*   Parameters:
+*           start: Where the path starts on this axis.
+*           delta: How far the path moves on this axis.
+*           size: The width of the box.
+*           enter: The latest entry time so far, 0 to FIX_ONE along the path.
+*           leave: The earliest exit time so far.
+*
+*   Returns: 0 if the path misses the slab or only crosses it outside the
+*            time left by the other axis.
+*/
+static uint8_t collide_slab(fix_t start, fix_t delta, fix_t size, int32_t * enter, int32_t * leave)
+{
+    if(delta == 0)
+        return start >= 0 && start <= size;
+
+    int32_t t0 = ((int32_t)(0 - start) << FIX_SHIFT) / delta;
+    int32_t t1 = ((int32_t)(size - start) << FIX_SHIFT) / delta;
+    if(t0 > t1)
+    {
+        int32_t swap = t0;
+        t0 = t1;
+        t1 = swap;
+    }
+    if(t0 > *enter)
+        *enter = t0;
+    if(t1 < *leave)
+        *leave = t1;
+    return *enter <= *leave;
+}
+
+/**
+*   Function for testing whether a point hit a box at some time during the
+*   last step rather than only where it ended up, so nothing moving faster
+*   than the box is wide can step over it.
+*
+*   Parameters:
+*           x, y: Where the point is now, relative to the top left of the box.
+*           dx, dy: How far the point moved relative to the box this step,
+*                   its own motion less the motion of the box.
+*           size: The width and height of the box, the far edges count as
+*                 inside like the old point in box tests.
+*
+*   Returns: 1 if the path from (x-dx, y-dy) to (x, y) touches the box.
+*
+*   Note: Most pairs are thrown out by the bounding box of the path, the
+*         divides in the slab test only run for paths that pass close by
+*         a corner.
+*/
+uint8_t collide_swept(fix_t x, fix_t y, fix_t dx, fix_t dy, fix_t size)
+{
+    fix_t x0 = x - dx;
+    fix_t y0 = y - dy;
+
+    if((x < 0 && x0 < 0) || (x > size && x0 > size)
+       || (y < 0 && y0 < 0) || (y > size && y0 > size))
+        return 0;
+
+    if(x >= 0 && x <= size && y >= 0 && y <= size)
+        return 1;
+
+    int32_t enter = 0;
+    int32_t leave = FIX_ONE;
+    return collide_slab(x0, dx, size, &enter, &leave)
+           && collide_slab(y0, dy, size, &enter, &leave);
+}
+
+/**
+*   Function for building the collision mask of a sprite.
+*
+*   Parameters:
+*           rows: The sprite, a byte per row with bit 7 as the left column.
+*           size: The width and height of the sprite, at most 7.
+*           mask: Where the size+1 rows of the mask are written.
+*/
+void collide_build_mask(const uint8_t * rows, uint8_t size, uint8_t * mask)
+{
+    uint8_t above = 0;
+    for(uint8_t row=0; row<=size; row++)
+    {
+        // Flip the row so bit c is column c.
+        uint8_t columns = 0;
+        if(row < size)
+        {
+            for(uint8_t c=0; c<size; c++)
+            {
+                if(rows[row] & (0x80 >> c))
+                    columns |= 1 << c;
+            }
+        }
+        // A bolt covers its own row and column and the ones after it.
+        uint8_t covered = above | columns;
+        mask[row] = covered | (covered << 1);
+        above = columns;
+    }
+}
+
+/**
+*   Function for testing whether a bolt overlapped a sprite at any point
+*   during the last step.
+*
+*   Parameters:
+*           x, y: Where the bolt is now relative to the top left of the
+*                 sprite, floor of each for the pixels as drawn.
+*           dx, dy: How far the bolt moved relative to the sprite this step.
+*           mask: The sprite collision mask from collide_build_mask.
+*           size: The width and height of the sprite.
+*
+*   Returns: 1 if the bolt touched a set pixel of the sprite.
+*
+*   Note: The path is first checked against the box around the mask by
+*         collide_swept, then walked a mask cell at a time from where the
+*         bolt started to where it is now, so every cell the path crosses
+*         is tested however little of it is cut. Each cell is one AND
+*         against a mask row, and which edge the path crosses next is found
+*         by comparing the distances to the next column and row edges
+*         scaled by the motion across, without a divide. A path through
+*         the exact corner of four cells goes on to the diagonal one, the
+*         two it only touches at a point are never where the bolt is drawn.
+*/
+uint8_t collide_sprite(fix_t x, fix_t y, fix_t dx, fix_t dy, const uint8_t * mask, uint8_t size)
+{
+    // Move to mask coordinates, which start one pixel up and left.
+    x += FIX_ONE;
+    y += FIX_ONE;
+    if(!collide_swept(x, y, dx, dy, (size+1)*FIX_ONE))
+        return 0;
+
+    fix_t x0 = x - dx;
+    fix_t y0 = y - dy;
+    int16_t column = x0 >> FIX_SHIFT, end_column = x >> FIX_SHIFT;
+    int16_t row = y0 >> FIX_SHIFT, end_row = y >> FIX_SHIFT;
+    int8_t step_column = dx < 0 ? -1 : 1;
+    int8_t step_row = dy < 0 ? -1 : 1;
+    int32_t across_x = dx < 0 ? -dx : dx;
+    int32_t across_y = dy < 0 ? -dy : dy;
+
+    // How far the path goes along each axis before it crosses a cell edge.
+    int32_t to_column = dx < 0 ? x0 - (column << FIX_SHIFT) : ((column+1) << FIX_SHIFT) - x0;
+    int32_t to_row = dy < 0 ? y0 - (row << FIX_SHIFT) : ((row+1) << FIX_SHIFT) - y0;
+
+    for(;;)
+    {
+        if(column >= 0 && row >= 0 && column <= size && row <= size && (mask[row] & (1 << column)))
+            return 1;
+        if(column == end_column && row == end_row)
+            return 0;
+        // The column edge comes first when to_column/across_x is the
+        // smaller time, both at once when the path goes through a corner.
+        int32_t column_time = to_column * across_y;
+        int32_t row_time = to_row * across_x;
+        uint8_t cross_column = column != end_column && (row == end_row || column_time <= row_time);
+        uint8_t cross_row = row != end_row && (column == end_column || row_time <= column_time);
+        if(cross_column)
+        {
+            column += step_column;
+            to_column += FIX_ONE;
+        }
+        if(cross_row)
+        {
+            row += step_row;
+            to_row += FIX_ONE;
+        }
+    }
+}
+
+/**
+*   Function for building the ship zone from the ship sprite.
+*
+*   Parameters:
+*           zone: The COLLIDE_ZONE_BYTES bitset to fill.
+*           x: The screen column of the left of the sprite.
+*           columns: The sprite, one byte per column, empty columns are left
+*                    out of the zone.
+*           width: The number of sprite columns.
+*/
+void collide_zone_build(uint8_t * zone, uint8_t x, const uint8_t * columns, uint8_t width)
+{
+    for(uint8_t i=0; i<COLLIDE_ZONE_BYTES; i++)
+    {
+        zone[i] = 0;
+    }
+    for(uint8_t i=0; i<width && x+i<LCD_X; i++)
+    {
+        if(columns[i])
+            zone[(x+i) >> 3] |= 1 << ((x+i) & 7);
+    }
+}
+
+/**
+*   Returns non zero if any of the columns x to x+width-1 are in the zone,
+*   columns off the screen are never in it.
+*/
+uint8_t collide_zone_hit(const uint8_t * zone, int16_t x, uint8_t width)
+{
+    for(uint8_t i=0; i<width; i++, x++)
+    {
+        if(x >= 0 && x < LCD_X && (zone[x >> 3] & (1 << (x & 7))))
+            return 1;
+    }
+    return 0;
+}
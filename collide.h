@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include "lcd.h"
+
+// Collision tests work in Q8.8 fixed point, the integer part covers the
+// screen and the off screen pool coordinates with plenty to spare.
+typedef int16_t fix_t;
+#define FIX_SHIFT 8
+#define FIX_ONE (1<<FIX_SHIFT)
+#define TO_FIX(value) ((fix_t)((value)*FIX_ONE))
+#define FIX_FLOOR(value) ((fix_t)((value) & ~(FIX_ONE-1)))
+
+// A collision mask has a byte per row with bit c set where a bolt, drawn
+// 2x2 from its top left, overlaps the sprite when its top left is in column
+// c-1 and the row index less one. So rows and columns run from -1 to
+// size-1 of the sprite and a mask covers sprites up to 7 wide.
+// collide_sprite tests every cell a bolt's path crosses, however small the
+// part of it the path cuts.
+#define COLLIDE_MASK_MAX 8
+
+// The ship zone is a bitset of the screen columns the ship sprite covers,
+// bit x&7 of byte x>>3.
+#define COLLIDE_ZONE_BYTES ((LCD_X+7)/8)
+
+uint8_t collide_swept(fix_t x, fix_t y, fix_t dx, fix_t dy, fix_t size);
+void collide_build_mask(const uint8_t * rows, uint8_t size, uint8_t * mask);
+uint8_t collide_sprite(fix_t x, fix_t y, fix_t dx, fix_t dy, const uint8_t * mask, uint8_t size);
+void collide_zone_build(uint8_t * zone, uint8_t x, const uint8_t * columns, uint8_t width);
+uint8_t collide_zone_hit(const uint8_t * zone, int16_t x, uint8_t width);
@@ -0,0 +1,190 @@
+#include <stdint.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include <graphics.h>
+#include <ascii_font.h>
+#include "lcd.h"
+#include "framebuffer.h"
+
+/**
+*   Returns the width of a string in pixels.
+*/
+uint8_t fb_string_width(const char * string)
+{
+    uint8_t width=0;
+    while(*string++)
+    {
+        width += FB_CHAR_WIDTH;
+    }
+    return width;
+}
+
+/**
+*   Returns one column of a glyph from the flash font, bit 0 is the top row.
+*
+*   Parameters:
+*           character: The character, anything unprintable is drawn as a space.
+*           column: The column of the glyph, 0 to FB_CHAR_WIDTH-1.
+*/
+uint8_t fb_glyph_column(char character, uint8_t column)
+{
+    if(character < ' ' || character > '~')
+        character = ' ';
+    return pgm_read_byte(&ASCII[character - ' '][column]);
+}
+
+/**
+*   Function for writing a glyph straight into the screen buffer a column
+*   byte at a time, rather than a pixel at a time through draw_pixel.
+*
+*   Parameters:
+*           x: The left x position of the character.
+*           y: The top y position of the character.
+*           character: The character to be drawn.
+*           colour: FG_COLOUR draws the glyph, BG_COLOUR draws it inverted,
+*                   the whole 5x8 cell is written either way like draw_char.
+*
+*   Note: When y is a multiple of 8 the glyph lines up with a bank of the
+*         buffer and each column is a single byte write, otherwise each
+*         column is shifted across the two banks it overlaps.
+*/
+void fb_draw_char(uint8_t x, uint8_t y, char character, colour_t colour)
+{
+    if(y >= LCD_Y)
+        return;
+    uint8_t invert = colour == FG_COLOUR ? 0x00 : 0xFF;
+    uint8_t bank = y >> 3;
+    uint8_t shift = y & 7;
+    uint8_t * top = &screen_buffer[bank*LCD_X];
+    uint8_t * bottom = top + LCD_X;
+    uint8_t has_bottom = bank+1 < LCD_Y/8;
+
+    for(uint8_t i=0; i<FB_CHAR_WIDTH && x<LCD_X; i++, x++)
+    {
+        uint8_t column = fb_glyph_column(character, i) ^ invert;
+
+        if(shift==0)
+        {
+            top[x] = column;
+        }
+        else
+        {
+            top[x] = (top[x] & (0xFF >> (8-shift))) | (column << shift);
+            if(has_bottom)
+            {
+                bottom[x] = (bottom[x] & (0xFF << shift)) | (column >> (8-shift));
+            }
+        }
+    }
+}
+
+/**
+*   Function for writing a string straight into the screen buffer, a drop in
+*   replacement for draw_string.
+*
+*   Parameters:
+*           x: The left x position of the string.
+*           y: The top y position of the string.
+*           string: The string to be drawn.
+*           colour: FG_COLOUR or BG_COLOUR, see fb_draw_char.
+*/
+void fb_draw_string(uint8_t x, uint8_t y, const char * string, colour_t colour)
+{
+    while(*string && x<LCD_X)
+    {
+        fb_draw_char(x, y, *string++, colour);
+        x += FB_CHAR_WIDTH;
+    }
+}
+
+/**
+*   Function for filling a rectangle of the screen buffer with a repeating
+*   column pattern, whole bank rows are filled with memset and partial banks
+*   with a masked OR (pixels on) or AND (pixels off).
+*
+*   Parameters:
+*           x: The left x position of the rectangle.
+*           y: The top y position of the rectangle.
+*           width: The width of the rectangle.
+*           height: The height of the rectangle.
+*           pattern: Bit (column & 7) decides if a column is on or off, so
+*                    FB_SOLID fills, FB_CLEAR clears and FB_DOTTED draws
+*                    every other column.
+*/
+void fb_fill_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint8_t pattern)
+{
+    if(x >= LCD_X || y >= LCD_Y)
+        return;
+    if(x + width > LCD_X)
+        width = LCD_X - x;
+    if(y + height > LCD_Y)
+        height = LCD_Y - y;
+
+    uint8_t bottom = y + height;
+    while(y < bottom)
+    {
+        uint8_t bank = y >> 3;
+        uint8_t first = y & 7;
+        uint8_t last = bottom - (bank << 3) > 8 ? 8 : bottom - (bank << 3);
+        uint8_t mask = (0xFF << first) & (0xFF >> (8 - last));
+        uint8_t * row = &screen_buffer[bank*LCD_X + x];
+
+        if(mask == 0xFF && (pattern == FB_SOLID || pattern == FB_CLEAR))
+        {
+            memset(row, pattern, width);
+        }
+        else
+        {
+            for(uint8_t i=0; i<width; i++)
+            {
+                if(pattern & (1 << ((x + i) & 7)))
+                    row[i] |= mask;
+                else
+                    row[i] &= ~mask;
+            }
+        }
+        y = (bank + 1) << 3;
+    }
+}
+
+/**
+*   Function for drawing a single pixel high row with a repeating pattern,
+*   see fb_fill_rect.
+*/
+void fb_pattern_row(uint8_t x, uint8_t y, uint8_t width, uint8_t pattern)
+{
+    fb_fill_rect(x, y, width, 1, pattern);
+}
+
+/**
+*   Function for ORing a sprite stored as column bytes into the screen buffer,
+*   each column is shifted across the two banks it overlaps like a glyph.
+*
+*   Parameters:
+*           x: The left x position of the sprite.
+*           y: The top y position of the sprite.
+*           columns: The sprite, one byte per column with bit 0 the top row.
+*           width: The number of columns in the sprite.
+*
+*   Note: Only set pixels are written, anything below the last row of the
+*         screen is dropped.
+*/
+void fb_blit_columns(uint8_t x, uint8_t y, const uint8_t * columns, uint8_t width)
+{
+    if(y >= LCD_Y)
+        return;
+    uint8_t bank = y >> 3;
+    uint8_t shift = y & 7;
+    uint8_t * top = &screen_buffer[bank*LCD_X];
+    uint8_t * bottom = top + LCD_X;
+    uint8_t has_bottom = bank+1 < LCD_Y/8;
+
+    for(uint8_t i=0; i<width && x<LCD_X; i++, x++)
+    {
+        top[x] |= columns[i] << shift;
+        if(shift && has_bottom)
+        {
+            bottom[x] |= columns[i] >> (8-shift);
+        }
+    }
+}
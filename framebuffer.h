@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <graphics.h>
+#include "lcd.h"
+
+// Each glyph is 5 columns of 8 pixels, one byte per column.
+#define FB_CHAR_WIDTH 5
+
+// Width of a string literal in pixels, worked out at compile time.
+#define FB_TEXT_WIDTH(literal) ((uint8_t)((sizeof(literal)-1)*FB_CHAR_WIDTH))
+
+// Left x for centering something of the given width on the screen.
+#define FB_CENTRE(width) ((uint8_t)((LCD_X-(width))/2))
+
+// Column patterns for fb_fill_rect and fb_pattern_row.
+#define FB_SOLID 0xFF
+#define FB_CLEAR 0x00
+#define FB_DOTTED 0x55
+
+uint8_t fb_string_width(const char * string);
+uint8_t fb_glyph_column(char character, uint8_t column);
+void fb_draw_char(uint8_t x, uint8_t y, char character, colour_t colour);
+void fb_draw_string(uint8_t x, uint8_t y, const char * string, colour_t colour);
+void fb_fill_rect(uint8_t x, uint8_t y, uint8_t width, uint8_t height, uint8_t pattern);
+void fb_pattern_row(uint8_t x, uint8_t y, uint8_t width, uint8_t pattern);
+void fb_blit_columns(uint8_t x, uint8_t y, const uint8_t * columns, uint8_t width);
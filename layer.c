@@ -0,0 +1,183 @@
+#include <stdint.h>
+#include <graphics.h>
+#include "lcd.h"
+#include "framebuffer.h"
+#include "layer.h"
+
+/**
+*   A run of pre-rendered text columns in the layer.
+*
+*   x: The left x position on the screen.
+*   bank: The bank (row of 8 pixels) of the screen the text sits in.
+*   width: Number of columns.
+*   offset: Position of the first column in the pool.
+*   value: Last value rendered into a numeric field.
+*/
+typedef struct
+{
+    uint8_t x;
+    uint8_t bank;
+    uint8_t width;
+    uint16_t offset;
+    int16_t value;
+} layer_item_t;
+
+static uint8_t layer_pool[LAYER_POOL_SIZE];
+static uint16_t layer_used=0;
+static layer_item_t layer_items[LAYER_MAX_ITEMS];
+static uint8_t layer_count=0;
+
+// Key of the set of screens currently rasterised, 0xFF forces a rebuild.
+static uint8_t layer_key=0xFF;
+
+/**
+*   Function for checking whether the layer holds the requested screens.
+*
+*   Parameters:
+*           key: A value identifying the set of screens wanted.
+*
+*   Return: 1 when the key has changed, the layer is emptied and the caller
+*           has to add the text for the new key, otherwise 0.
+*/
+uint8_t layer_begin(uint8_t key)
+{
+    if(key == layer_key)
+        return 0;
+    layer_key = key;
+    layer_used = 0;
+    layer_count = 0;
+    return 1;
+}
+
+/**
+*   Function for reserving space in the pool for a run of text.
+*
+*   Return: The index of the new item or LAYER_NO_ITEM when full.
+*/
+static uint8_t layer_reserve(uint8_t x, uint8_t y, uint8_t width)
+{
+    if(layer_count == LAYER_MAX_ITEMS || layer_used + width > LAYER_POOL_SIZE || x >= LCD_X)
+        return LAYER_NO_ITEM;
+    if(x + width > LCD_X)
+        width = LCD_X - x;
+
+    layer_item_t * item = &layer_items[layer_count];
+    item->x = x;
+    item->bank = y >> 3;
+    item->width = width;
+    item->offset = layer_used;
+    layer_used += width;
+    return layer_count++;
+}
+
+/**
+*   Function for rasterising text into an item, any columns left over are
+*   cleared.
+*/
+static void layer_render(uint8_t index, const char * string)
+{
+    layer_item_t * item = &layer_items[index];
+    uint8_t * columns = &layer_pool[item->offset];
+
+    for(uint8_t i=0; i<item->width; i++)
+    {
+        if(*string)
+        {
+            columns[i] = fb_glyph_column(*string, i % FB_CHAR_WIDTH);
+            if(i % FB_CHAR_WIDTH == FB_CHAR_WIDTH-1)
+                string++;
+        }
+        else
+            columns[i] = 0;
+    }
+}
+
+/**
+*   Function for adding static text to the layer, it is rasterised once here
+*   and only composited from then on.
+*
+*   Parameters:
+*           x: The left x position of the text.
+*           y: The top y position of the text, rounded down to a bank.
+*           string: The text.
+*/
+void layer_add_text(uint8_t x, uint8_t y, const char * string)
+{
+    uint8_t index = layer_reserve(x, y, fb_string_width(string));
+    if(index != LAYER_NO_ITEM)
+        layer_render(index, string);
+}
+
+/**
+*   Function for adding a numeric field to the layer.
+*
+*   Parameters:
+*           x: The left x position of the field.
+*           y: The top y position of the field, rounded down to a bank.
+*           chars: The widest the number can be in characters.
+*
+*   Return: The item to pass to layer_set_int.
+*/
+uint8_t layer_add_field(uint8_t x, uint8_t y, uint8_t chars)
+{
+    uint8_t index = layer_reserve(x, y, chars * FB_CHAR_WIDTH);
+    if(index != LAYER_NO_ITEM)
+    {
+        layer_items[index].value = 0;
+        layer_render(index, "0");
+    }
+    return index;
+}
+
+/**
+*   Function for updating a numeric field, the digits are only rasterised
+*   again when the value has changed.
+*
+*   Parameters:
+*           item: The field returned by layer_add_field.
+*           value: The value to show.
+*/
+void layer_set_int(uint8_t item, int16_t value)
+{
+    if(item >= layer_count || layer_items[item].value == value)
+        return;
+    layer_items[item].value = value;
+
+    // Largest int16_t is 6 characters with the sign
+    char text[7];
+    char * p = &text[6];
+    uint16_t magnitude = value < 0 ? -(int32_t)value : value;
+    *p = '\0';
+    do
+    {
+        *--p = '0' + magnitude % 10;
+        magnitude /= 10;
+    }
+    while(magnitude);
+    if(value < 0)
+        *--p = '-';
+
+    layer_render(item, p);
+}
+
+/**
+*   Function for compositing the layer onto the screen buffer, one OR per
+*   column byte. The bank under each item is cleared first so the text is
+*   opaque like the library's draw_string, rocks passing behind it do not
+*   show through the gaps in the glyphs.
+*/
+void layer_draw()
+{
+    for(uint8_t i=0; i<layer_count; i++)
+    {
+        layer_item_t * item = &layer_items[i];
+        uint8_t * columns = &layer_pool[item->offset];
+        uint8_t * screen = &screen_buffer[item->bank*LCD_X + item->x];
+
+        fb_fill_rect(item->x, item->bank << 3, item->width, 8, FB_CLEAR);
+        for(uint8_t j=0; j<item->width; j++)
+        {
+            screen[j] |= columns[j];
+        }
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+// Bytes of pre-rendered columns the layer can hold, one byte per column
+// of text, and the number of text items it can hold.
+#define LAYER_POOL_SIZE 288
+#define LAYER_MAX_ITEMS 10
+
+// Returned by layer_add_field when the layer is full.
+#define LAYER_NO_ITEM 0xFF
+
+uint8_t layer_begin(uint8_t key);
+void layer_add_text(uint8_t x, uint8_t y, const char * string);
+uint8_t layer_add_field(uint8_t x, uint8_t y, uint8_t chars);
+void layer_set_int(uint8_t item, int16_t value);
+void layer_draw(void);
@@ -0,0 +1,135 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <macros.h>
+#include "led_pattern.h"
+
+// Wave warning, waits out the 2 second wave delay then lights the LED on
+// the side the first asteroid will fall.
+const led_step_t led_warn_left[] PROGMEM =
+{
+    {0, LED_SECONDS(2)},
+    {LED0, LED_SECONDS(0.5)},
+    {0, 0}
+};
+const led_step_t led_warn_right[] PROGMEM =
+{
+    {0, LED_SECONDS(2)},
+    {LED1, LED_SECONDS(0.5)},
+    {0, 0}
+};
+
+// Both LEDs blinking together while the game over message is up.
+const led_step_t led_game_over[] PROGMEM =
+{
+    {LED0|LED1, LED_SECONDS(0.25)},
+    {0, LED_SECONDS(0.25)},
+    {0, 0}
+};
+
+// Alternating LEDs after a debug cheat, played LED_DEBUG_REPEATS times.
+const led_step_t led_debug[] PROGMEM =
+{
+    {LED0, LED_SECONDS(0.1)},
+    {0, LED_SECONDS(0.4)},
+    {LED1, LED_SECONDS(0.1)},
+    {0, LED_SECONDS(0.4)},
+    {0, 0}
+};
+
+static const led_step_t * led_pattern=NULL;
+static const led_step_t * led_step;
+static uint8_t led_remaining;
+static uint8_t led_repeats;
+static uint8_t led_divider;
+
+/**
+*   Function for setting LED0 (PORTB 2) and LED1 (PORTB 3), single bit
+*   writes are used as the LCD shares PORTB.
+*/
+static void led_write(uint8_t leds)
+{
+    if(leds & LED0)
+        SET_BIT(PORTB,2);
+    else
+        CLEAR_BIT(PORTB,2);
+    if(leds & LED1)
+        SET_BIT(PORTB,3);
+    else
+        CLEAR_BIT(PORTB,3);
+}
+
+/**
+*   Function for loading the step led_step points at.
+*/
+static void led_load_step()
+{
+    led_remaining = pgm_read_byte(&led_step->duration);
+    led_write(pgm_read_byte(&led_step->leds));
+}
+
+/**
+*   Function for starting a pattern, replacing whatever was playing.
+*
+*   Parameters:
+*           pattern: The PROGMEM pattern to play.
+*           repeats: How many times the pattern is played, 0 repeats it
+*                    until stopped.
+*/
+void led_pattern_play(const led_step_t * pattern, uint8_t repeats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        led_pattern = led_step = pattern;
+        led_repeats = repeats;
+        led_divider = 0;
+        led_load_step();
+    }
+}
+
+/**
+*   Function for stopping the current pattern and turning both LEDs off.
+*/
+void led_pattern_stop()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        led_pattern = NULL;
+        led_write(0);
+    }
+}
+
+/**
+*   Function for stepping the current pattern, called on every Timer0
+*   overflow.
+*/
+void led_pattern_tick()
+{
+    if(!led_pattern)
+        return;
+    if(++led_divider < LED_STEP_TICKS)
+        return;
+    led_divider = 0;
+
+    if(led_remaining > 1)
+    {
+        led_remaining--;
+        return;
+    }
+
+    led_step++;
+    if(pgm_read_byte(&led_step->duration) == 0)
+    {
+        if(led_repeats == 1)
+        {
+            led_pattern_stop();
+            return;
+        }
+        if(led_repeats)
+            led_repeats--;
+        led_step = led_pattern;
+    }
+    led_load_step();
+}
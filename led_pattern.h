@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+// LED bits used in pattern steps.
+#define LED0 0x01
+#define LED1 0x02
+
+// Step durations are counted in units of 4 Timer0 overflows (8.192ms),
+// this converts seconds to those units (max approx 2 seconds per step).
+#define LED_STEP_TICKS 4
+#define LED_SECONDS(s) ((uint8_t)((s) * 8000000.0 / (64.0 * 256.0 * LED_STEP_TICKS)))
+
+/**
+*   A single step in a PROGMEM LED pattern, a step with a duration of 0 marks
+*   the end of the pattern.
+*
+*   leds: The LEDs that are on for the step (LED0 | LED1).
+*   duration: How long the step lasts, see LED_SECONDS.
+*/
+typedef struct
+{
+    uint8_t leds;
+    uint8_t duration;
+} led_step_t;
+
+extern const led_step_t led_warn_left[];
+extern const led_step_t led_warn_right[];
+extern const led_step_t led_game_over[];
+extern const led_step_t led_debug[];
+
+// Times led_debug plays after a cheat, about 3 seconds, so the LEDs do not
+// keep blinking for the rest of a game that is never reset.
+#define LED_DEBUG_REPEATS 3
+
+void led_pattern_play(const led_step_t * pattern, uint8_t repeats);
+void led_pattern_stop(void);
+void led_pattern_tick(void);
@@ -3,7 +3,9 @@
 #include <string.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
+#include <util/atomic.h>
 #include <cpu_speed.h>
 #include <macros.h>
 #include <graphics.h>
@@ -12,10 +14,35 @@
 #include <lcd_model.h>
 #include "usb_serial.h"
 #include "cab202_adc.h"
+#include "serial_writer.h"
+#include "wave.h"
+#include "prng.h"
+#include "profiler.h"
+#include "backlight.h"
+#include "led_pattern.h"
+#include "framebuffer.h"
+#include "layer.h"
+#include "screen_stream.h"
+#include "remote.h"
+#include "snapshot.h"
+#include "throughput.h"
+#include "pool.h"
+#include "collide.h"
+#include "trig.h"
+#include "bench.h"
 #include "ram_utils.h"
 #include "lcd.h"
 #include "init.h"
 
+#ifdef BENCHMARK
+// The serial flood scene feeds its bytes in place of the USB port, and the
+// input scenes hold buttons down on port B as simavr has none to press.
+#define usb_serial_getchar bench_getchar
+#define usb_serial_available bench_available
+#undef PINB
+#define PINB (_SFR_IO8(0x03) | bench_pinb)
+#endif
+
 // Bit values for uint8_t gamestate.
 // Note: when cheated flag is set the pause flag is ignored in
 // certain functions this sets up a more productive debugging
@@ -28,6 +55,13 @@
 #define PAUSED 0x06
 #define QUIT 0x07
 
+// Set, clear, toggle and test a single gamestate bit, writes never touch
+// the other bits.
+#define GAME_SET(bit) (gamestate |= (1<<(bit)))
+#define GAME_CLEAR(bit) (gamestate &= ~(1<<(bit)))
+#define GAME_TOGGLE(bit) (gamestate ^= (1<<(bit)))
+#define GAME_IS(bit) BIT_IS_SET(gamestate,bit)
+
 // Movement directions
 #define LEFT 0xD8
 #define RIGHT 0xD1
@@ -50,11 +84,21 @@
 #define PROJECTILE_POOL -15
 #define POOL_COORDINATES -10
 
-// Max values calculated from the initial 3 asteroids.
-#define MAX_ASTEROID 3
-#define MAX_BOULDER (MAX_ASTEROID*2)
-#define MAX_FRAG (MAX_BOULDER*2)
-#define MAX_PROJECTILE 30
+// What fire_plasma_bolt does when every projectile is in flight, either
+// skip the shot or reuse the slot of the oldest bolt. Set from the makefile
+// with "make PROJECTILE_RECYCLE=1".
+#define PROJECTILE_REJECT 0
+#define PROJECTILE_RECYCLE 1
+#ifndef PROJECTILE_POLICY
+#define PROJECTILE_POLICY PROJECTILE_REJECT
+#endif
+
+// Pool indexes are stored in uint8_t, and asteroid 1 is used by the
+// object moving cheats.
+_Static_assert(MAX_ASTEROID >= 2, "MAX_ASTEROID must be at least 2");
+_Static_assert(MAX_FRAG <= POOL_SLOTS_MAX, "MAX_ASTEROID too large for the pool state bitsets");
+_Static_assert(MAX_PROJECTILE >= 1 && MAX_PROJECTILE <= POOL_SLOTS_MAX, "MAX_PROJECTILE out of range");
+_Static_assert(BROKEN < POOL_FLAGS, "Object state bits do not fit the pool flags");
 
 // uint8_t is used wherever the value is guaranteed >=0 || <= 255
 
@@ -67,43 +111,55 @@ void erase_ship(void);
 void draw_ship(void);
 void draw_int( uint8_t x, uint8_t y, int value, colour_t colour );
 void draw_double(uint8_t x, uint8_t y, double value, colour_t colour);
-void fire_plasma_bolt(void);
+uint8_t fire_plasma_bolt(void);
+void game_over_finish(void);
+void update_ship_sprite(void);
+uint16_t snapshot_game(uint8_t mode);
 int receive_serial_cheat();
-int serial_to_int(char *base, char target[1][3]);
+int serial_to_int(const char *base);
 
 //Time stuff
 double spawn_delay;
 double wave_time;
-double led_hz;
 double return_manual;
 double game_speed;
 
 //Game stuff
 uint8_t direction;
+uint16_t replay_seed=0;
 double game_time;
 
 int status_screen=0;
 
 int score;
-int flash_led=0;
 uint8_t led_state;
 
+#ifdef SERIAL_DEBUG
 char in_buff[12];
+#endif
 
 int turret_override=0;
 int speed_override=0;
 int intro_screen=1;
-int dim_lcd=0;
+
+// Game over sequence states (see game_over_stuff).
+#define GO_NONE 0
+#define GO_DIM 1
+#define GO_MESSAGE 2
+#define GO_CHOICES 3
+uint8_t game_over_state=GO_NONE;
 
 // Game state (see definition for bit values)
 uint8_t gamestate;
 
 //Stuff stuff
 char * student_num = "n10318399";
+uint8_t student_num_x;
 
 //Shield and ship stuff
 int shield_life;
 uint8_t ship_x;
+uint8_t ship_invulnerable=0;
 
 
 uint8_t falling_objects;
@@ -111,26 +167,32 @@ uint8_t falling_objects;
 //Asteroid stuff
 double ax[MAX_ASTEROID], ay[MAX_ASTEROID];
 int asteroid_tick[MAX_ASTEROID];
-uint8_t asteroid_state[MAX_ASTEROID];
+pool_t asteroid_pool;
 
 //boulder stuff
 double bx[MAX_BOULDER], by[MAX_BOULDER], bdx[MAX_BOULDER], bdy[MAX_BOULDER];
 int boulder_tick[MAX_BOULDER];
-uint8_t boulder_state[MAX_BOULDER];
+pool_t boulder_pool;
 
 //fragment stuff
 double fx[MAX_FRAG], fy[MAX_FRAG], fdx[MAX_FRAG], fdy[MAX_FRAG];
 int fragment_tick[MAX_FRAG];
-uint8_t fragment_state[MAX_FRAG];
+pool_t fragment_pool;
 
 //turret stuff and projectile pool
 double tx, ty;
 double px[MAX_PROJECTILE],py[MAX_PROJECTILE],pdx[MAX_PROJECTILE],pdy[MAX_PROJECTILE];
 int projectile_tick[MAX_PROJECTILE];
 double fireTimer=0;
-uint8_t projectile_state[MAX_PROJECTILE];
+pool_t projectile_pool;
 double projectile_heading[MAX_PROJECTILE];
 int fired;
+#if PROJECTILE_POLICY == PROJECTILE_RECYCLE
+// Shot number of the bolt in each slot, the oldest bolt has the largest
+// projectile_shots - projectile_shot[i] (mod 256).
+uint8_t projectile_shot[MAX_PROJECTILE];
+uint8_t projectile_shots;
+#endif
 
 // ----------------------------------------------------------
 
@@ -147,6 +209,28 @@ int fired;
 #define PRESCALE 64.0
 #define TIMER_SCALE 256.0
 
+// Converts seconds to a number of Timer0 overflows.
+#define SECONDS_TO_TICKS(s) ((uint16_t)((s) * FREQ / (PRESCALE * TIMER_SCALE)))
+
+// Timer0 overflow count, used for timing anything that runs in the main loop.
+volatile uint16_t ticks=0;
+
+// Set while a snapshot is taken or loaded to hold off the Timer0 game update.
+volatile uint8_t game_frozen=0;
+
+/**
+*   Returns the tick count, read with interrupts off as it is 16 bits.
+*/
+uint16_t get_ticks()
+{
+    uint16_t now;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        now = ticks;
+    }
+    return now;
+}
+
 
 
 uint8_t mask = 0b1111;
@@ -223,6 +307,7 @@ void joy_click()
 
 uint8_t ship_tick=0;
 uint8_t dynamic_ship_width;
+extern uint8_t ship_sprite_width;
 uint8_t ship_speed=15;
 /**
 *   Function for handling the ships x offset, speed and making sure the ship
@@ -236,10 +321,8 @@ void ship_movement()
         // If the turret is at a heading >0 and the ship is in a position
         // where moving the turret will leave screen space then override the
         // left pot value and set the turret x position to fit int the screen.
-        if(tx<=0)
-            dynamic_ship_width=9;
-        else
-            dynamic_ship_width = 9+tx;
+        update_ship_sprite();
+        dynamic_ship_width = ship_sprite_width;
         if(ship_x+9+tx>83)
         {
             turret_override=1;
@@ -276,109 +359,17 @@ void ship_movement()
 }
 
 /**
-*   A function designed to randomly shuffle an array of uint8_t values
-*
-*   Parameters:
-*           array: a pointer that leads to the array to be shuffled
-*
-*   Note: no null check in place so the for loop is set at a static value
-*         indicative of the MAX_ASTEROID value, in the future a null check
-*         should be added and the second argument in the for loop changed
-*         to < length of array to make it a more dynamic function.
-*/
-void shuffle_array(uint8_t * array)
-{
-    uint8_t i,j,tmp;
-
-    for(i=0; i<MAX_ASTEROID; i++)
-    {
-        j= rand()%3;
-        tmp=array[i];
-        array[i]=array[j];
-        array[j]=tmp;
-    }
-}
-
-/**
-*   Returns the number of objects moving on screen
+*   Returns non zero if any falling object is moving on screen
 *
-*   Return: A uint8_t value that represents then number of
-*           falling objects currently in play.
-*
-*   Note: this value does not return the projectile count in
-*         the total count.
+*   Note: projectiles are not included.
 **/
-uint8_t asteroid_count, boulder_count, frag_count, projectile_count;
 uint8_t spawn_check()
 {
-    asteroid_count =boulder_count =frag_count=projectile_count = 0;
-    for(uint8_t i=0; i<MAX_ASTEROID; i++)
-    {
-        if(BIT_IS_SET(asteroid_state[i],MOVING))
-            asteroid_count++;
-    }
-    for(uint8_t i=0; i<MAX_BOULDER; i++)
-    {
-        if(BIT_IS_SET(boulder_state[i],MOVING))
-            boulder_count++;
-    }
-    for(uint8_t i=0; i<MAX_FRAG; i++)
-    {
-        if(BIT_IS_SET(fragment_state[i],MOVING))
-            frag_count++;
-    }
-    for(uint8_t i=0; i<MAX_FRAG; i++)
-    {
-        if(BIT_IS_SET(projectile_state[i],MOVING))
-            projectile_count++;
-    }
-
-    return  asteroid_count+boulder_count+frag_count;
-}
-
-
-/**
-*   A function for flashing LED0 and 1 output at a specified Hz value.
-*
-*   Note: To get the second value of Hz: seconds = 1 / Hz.
-*         To get the Hz representation of a second value: Hz = 1 / seconds.
-*/
-void led_flash(double hz)
-{
-    if(flash_led)
-    {
-        led_hz = 0;
-        if(!BIT_IS_SET(gamestate,OVER))
-        {
-            uint8_t tmp;
-
-            // Checks the middle asteroid to see if it is to the left or right
-            // of center screen,
-            if(ax[1]+3>LCD_X/2)
-                tmp = 3;
-            else
-                tmp = 2;
-            SET_BIT(PORTB,tmp);
-        }
-        else
-        {
-            SET_BIT(PORTB,3);
-            SET_BIT(PORTB,2);
-        }
-
-        flash_led =0;
-
-    }
-    if(led_hz >= 0.5)
-    {
-        CLEAR_BIT(PORTB,3);
-        CLEAR_BIT(PORTB,2);
-    }
-
+    return pool_any(&asteroid_pool,MOVING) || pool_any(&boulder_pool,MOVING)
+           || pool_any(&fragment_pool,MOVING);
 }
 
 
-
 /***
 *   A function for holding all of the timers that gets called in the
 *   ISR function.
@@ -394,9 +385,6 @@ void timers()
     if(wave_time> 10)
         wave_time=0;
     wave_time += TIMER_SCALE * PRESCALE / FREQ;
-    if(led_hz>40)
-        led_hz=0;
-    led_hz += TIMER_SCALE * PRESCALE / FREQ;
 
     // Handles the manual override return switching for the pots
     return_manual += TIMER_SCALE * PRESCALE / FREQ;
@@ -409,75 +397,118 @@ void timers()
 }
 
 
-double lcd_led_value=1023;
+uint8_t wave_started=0;
+uint8_t array_pos[MAX_ASTEROID];
+uint8_t count=0;
+double rand_delay;
+
+// Current position in the wave table and the loaded entry.
+uint8_t wave_number=0;
+wave_t wave;
+// Fall speed of the current wave in tenths, a byte so that the draw code
+// reads it whole while the game tick loads a new wave.
+uint8_t wave_speed=10;
+
 /**
-*   A function to  dim the the LCD LED
-*
-*   Note: dimming is controlled by th global variable
-*         dim_lcd, when set the lcd will dim over 2 seconds
-          (0.002048 overflow * 1023), when not set it will
-          return from current value to 0 at the same rate.
+*   Function for setting the order the asteroid slots are spawned in for the
+*   current wave. Waves with a precomputed order in the table use it as long
+*   as every slot in it exists in the pool, otherwise the slots are shuffled.
 */
-void lcd_dimmer()
+void plan_spawn_order()
 {
-    if(dim_lcd)
+    uint8_t i;
+    for(i=0; i<MAX_ASTEROID; i++)
     {
-        lcd_led_value++;
-
+        array_pos[i]=i;
     }
-    else
-        lcd_led_value--;
+    if(wave.order)
+    {
+        for(i=0; i<wave.asteroids; i++)
+        {
+            uint8_t slot = pgm_read_byte(&wave.order[i]);
+            if(slot >= MAX_ASTEROID)
+                break;
+            array_pos[i]=slot;
+        }
+        if(i==wave.asteroids)
+            return;
+        for(i=0; i<MAX_ASTEROID; i++)
+        {
+            array_pos[i]=i;
+        }
+    }
+    prng_shuffle(PRNG_WAVE,array_pos,MAX_ASTEROID);
+}
 
-    if(lcd_led_value>1023)
-        lcd_led_value=1023;
-    if(lcd_led_value<0)
-        lcd_led_value=0;
+/**
+*   Function for picking a random delay before the next spawn within the
+*   range given by the current wave.
+*/
+double wave_delay()
+{
+    return (double)(prng_range(PRNG_WAVE,wave.max_delay-wave.min_delay+1)+wave.min_delay)/10;
+}
+/**
+*   Function for loading the next entry of the wave table and planning its
+*   spawns, the wave's own delay has to pass before the first one falls.
+*/
+static void wave_start(void)
+{
+    wave_time=0;
+    wave_started=1;
+    wave_load(wave_number, &wave);
+    if(wave.asteroids > MAX_ASTEROID)
+        wave.asteroids = MAX_ASTEROID;
+    wave_speed = wave.speed;
+    if(wave_number < 255)
+        wave_number++;
+    plan_spawn_order();
+    rand_delay = wave_delay();
+
+    // Warn on the side of the screen the first asteroid falls.
+    if(ax[array_pos[0]]+3>LCD_X/2)
+        led_pattern_play(led_warn_right,1);
+    else
+        led_pattern_play(led_warn_left,1);
 }
 
-uint8_t wave_started=0;
-uint8_t array_pos[] = {0,1,2};
-uint8_t count=0;
-double rand_delay;
-ISR(TIMER0_OVF_vect)
+/**
+*   Function for the work done on every Timer0 overflow, the game clock,
+*   spawning and the fire rate.
+*/
+static void game_tick(void)
 {
+    ticks++;
     joy_click();
-    int on_screen = spawn_check();
+    led_pattern_tick();
+    if(game_frozen)
+        return;
+    uint8_t on_screen = spawn_check();
 
     timers();
 
-    lcd_dimmer();
-
-    if(!BIT_IS_SET(gamestate,PAUSED))
+    if(!GAME_IS(PAUSED))
     {
         game_time += TIMER_SCALE * PRESCALE / FREQ;
         if(game_speed >0)
         {
             //If no object are on screen then start the wave
-            if(on_screen==0 && !wave_started)
-            {
-                wave_time=0;
-                wave_started=1;
-                shuffle_array(array_pos);
-                rand_delay = (double)(rand()% 15+1)/10;
-                flash_led=1;
-            }
+            if(!on_screen && !wave_started)
+                wave_start();
 
             //Wave time delayed before start
             if(wave_time>2)
             {
-                led_flash(0.5);
-
-
                 //Delay between asteroids
                 if ( spawn_delay >= rand_delay)
                 {
-                    rand_delay = (double)(rand()% 15+1)/10;
-                    if(wave_started && !BIT_IS_SET(asteroid_state[array_pos[count]],(DRAWN|MOVING)))
+                    rand_delay = wave_delay();
+                    if(wave_started && !pool_is(&asteroid_pool,array_pos[count],MOVING))
                     {
-                        asteroid_state[array_pos[count]] = (1<<DRAWN)|(1<<MOVING);
+                        pool_set(&asteroid_pool,array_pos[count],(1<<DRAWN)|(1<<MOVING));
                         count++;
                     }
-                    if(count>=3)
+                    if(count>=wave.asteroids)
                     {
                         wave_started=0;
                         count =0;
@@ -489,7 +520,7 @@ ISR(TIMER0_OVF_vect)
 
     }
 
-    if(!BIT_IS_SET(gamestate,PAUSED)|| BIT_IS_SET(gamestate,CHEATED))
+    if(!GAME_IS(PAUSED)|| GAME_IS(CHEATED))
     {
         if(fireTimer >= 0.2 )
         {
@@ -499,6 +530,13 @@ ISR(TIMER0_OVF_vect)
     }
 }
 
+ISR(TIMER0_OVF_vect)
+{
+    profiler_isr_enter();
+    game_tick();
+    profiler_isr_exit();
+}
+
 /**
 *   Functions responsible for deciding what direction to shift to
 *   based on input and current direction
@@ -536,10 +574,10 @@ void move_right()
 // ---------------------------------------------------------
 
 
-char serial_out_buffer[30];
 /**
-*   Function for sending a string containing an integer value and a sting back
-*   to the serial console.
+*   Function for appending a string containing an integer value and a sting to
+*   the serial staging buffer, nothing is sent until the buffer fills or the
+*   caller commits it.
 *
 *   Parameters:
 *           int_in: An integer to be sent suffixed to the message
@@ -547,8 +585,24 @@ char serial_out_buffer[30];
 */
 void usb_serial_sent_int(int16_t int_in, char * message)
 {
-    snprintf( serial_out_buffer, sizeof(serial_out_buffer),"%s%d\r\n", message, int_in );
-    usb_serial_send( serial_out_buffer );
+    serial_writer_append(message);
+    serial_writer_append_int(int_in);
+    serial_writer_append("\r\n");
+}
+
+/**
+*   Function for appending a message and an unsigned value to the serial
+*   staging buffer, for values such as the seed that use all 16 bits.
+*
+*   Parameters:
+*           uint_in: An unsigned value to be sent suffixed to the message
+*           message: A string prefixing the value
+*/
+void usb_serial_sent_uint(uint16_t uint_in, char * message)
+{
+    serial_writer_append(message);
+    serial_writer_append_uint(uint_in);
+    serial_writer_append("\r\n");
 }
 
 /**
@@ -560,9 +614,8 @@ void usb_serial_sent_int(int16_t int_in, char * message)
 */
 void usb_serial_send(char * message)
 {
-    // Cast to avoid "error: pointer targets in passing argument 1
-    //	of 'usb_serial_write' differ in signedness"
-    usb_serial_write((uint8_t *) message, strlen(message));
+    serial_writer_append(message);
+    serial_writer_commit();
 }
 
 /**
@@ -575,7 +628,7 @@ void setup_usb_serial(void)
     // Set up LCD and display message
     new_lcd_init(LCD_DEFAULT_CONTRAST);
     lcd_clear();
-    draw_string(10, 10, "Connect USB...", FG_COLOUR);
+    fb_draw_string(10, 10, "Connect USB...", FG_COLOUR);
     show_screen();
 
     usb_init();
@@ -589,19 +642,31 @@ void setup_usb_serial(void)
 
 /**
 *   Function responsible for sending the game status to the serial console when
-*   called.
+*   called, the whole report is batched into as few full packets as possible.
 */
+uint8_t report_packets=0;
 void status_to_serial()
 {
+    uint16_t packets_before = serial_packets_sent;
+
     usb_serial_sent_int((int)game_time,"\r\nGame Time:");
     usb_serial_sent_int((int)shield_life,"Shield Life Remaining:");
     usb_serial_sent_int((int)score,"Score:");
-    usb_serial_sent_int((int)asteroid_count,"Asteroid Count:");
-    usb_serial_sent_int((int)boulder_count,"Boulder Count:");
-    usb_serial_sent_int((int)frag_count,"Fragment Count:");
-    usb_serial_sent_int((int)projectile_count,"Projectile Count:");
+    usb_serial_sent_int(pool_count(&asteroid_pool,MOVING),"Asteroid Count:");
+    usb_serial_sent_int(pool_count(&boulder_pool,MOVING),"Boulder Count:");
+    usb_serial_sent_int(pool_count(&fragment_pool,MOVING),"Fragment Count:");
+    usb_serial_sent_int(pool_count(&projectile_pool,MOVING),"Projectile Count:");
     usb_serial_sent_int((int)tx*20,"Turret angle:");
     usb_serial_sent_int((int)game_speed*10,"Game Speed:");
+    usb_serial_sent_int(report_packets,"Last Report Packets:");
+    usb_serial_sent_uint(prng_get_seed(),"Seed:");
+#ifdef SCREEN_STREAM
+    usb_serial_sent_int(screen_stream_frame_bytes,"Stream Bytes/Frame:");
+#endif
+    serial_writer_commit();
+
+    // Packets used by this report, shown as part of the next one.
+    report_packets = serial_packets_sent - packets_before;
 }
 
 /**
@@ -623,23 +688,75 @@ void status_to_serial()
 //    usb_serial_send("'i'  place fragment at coordinate \r\n '?'  show this screen");
 //}
 
+// Screens that are drawn through the cached text layer, the set wanted in a
+// frame is the layer key so each combination is only rasterised once.
+#define OVERLAY_INTRO 0x01
+#define OVERLAY_STATUS 0x02
+#define OVERLAY_OVER_MESSAGE 0x04
+#define OVERLAY_OVER_CHOICES 0x08
+uint8_t overlay_wanted=0;
+uint8_t time_field, life_field, score_field;
+
 /**
 *   Function responsible for sending the game status to the teensy screen when
 *   called.
 */
 void status_to_screen()
 {
-    draw_string(0,0,"Time: ",FG_COLOUR);
-    draw_int(30,0,(int)game_time,FG_COLOUR);
-    draw_string(0,10,"Life: ",FG_COLOUR);
-    draw_int(30,10,shield_life,FG_COLOUR);
-    draw_string(0,20,"Score: ",FG_COLOUR);
-    draw_int(30,20,score,FG_COLOUR);
+    overlay_wanted |= OVERLAY_STATUS;
+}
+
+/**
+*   Function responsible for compositing the text of every screen asked for
+*   this frame on to the screen buffer. The static text is only rasterised
+*   when the set of screens changes and the status numbers only when their
+*   values change.
+*
+*   Note: All text is placed on bank boundaries (multiples of 8) so each
+*         column is a single byte in the layer.
+*/
+void overlay_update()
+{
+    if(layer_begin(overlay_wanted))
+    {
+        if(overlay_wanted & OVERLAY_INTRO)
+        {
+            layer_add_text(student_num_x,8,student_num);
+            layer_add_text(FB_CENTRE(FB_TEXT_WIDTH("SPACE PEW PEW")),16,"SPACE PEW PEW");
+        }
+        if(overlay_wanted & OVERLAY_STATUS)
+        {
+            layer_add_text(0,0,"Time: ");
+            time_field = layer_add_field(30,0,4);
+            layer_add_text(0,8,"Life: ");
+            life_field = layer_add_field(30,8,4);
+            layer_add_text(0,16,"Score: ");
+            score_field = layer_add_field(30,16,4);
+        }
+        if(overlay_wanted & OVERLAY_OVER_MESSAGE)
+        {
+            layer_add_text(FB_CENTRE(FB_TEXT_WIDTH("GAME OVER")),16,"GAME OVER");
+        }
+        if(overlay_wanted & OVERLAY_OVER_CHOICES)
+        {
+            layer_add_text(LCD_X/2 - (8*5),16,"SW1 - Restart");
+            layer_add_text(LCD_X/2 - (8*5),24,"SW2 - Quit");
+        }
+    }
+    if(overlay_wanted & OVERLAY_STATUS)
+    {
+        layer_set_int(time_field,(int)game_time);
+        layer_set_int(life_field,shield_life);
+        layer_set_int(score_field,score);
+    }
+    layer_draw();
+    overlay_wanted=0;
 }
 
 // ---------------------------------------------------------
 //	Console cheats
 // ---------------------------------------------------------
+#ifdef SERIAL_DEBUG
 
 uint8_t new_x,new_y;
 /**
@@ -680,8 +797,8 @@ void do_move_object(uint8_t object_mask)
     // When called the serial console requests an x,y coordinate
     // if its the ship it will only ask for an x.
     usb_serial_send("Input x coordinates: - (0-84)\r\n");
-    gamestate |= (1<<INPUT);
-    while(BIT_IS_SET(gamestate,INPUT))
+    GAME_SET(INPUT);
+    while(GAME_IS(INPUT))
     {
         new_x = receive_serial_cheat();
     }
@@ -689,8 +806,8 @@ void do_move_object(uint8_t object_mask)
     if(object_mask!=SHIP)
     {
         usb_serial_send("Input y coordinates: - (0-39)\r\n");
-        gamestate |= (1<<INPUT);
-        while(BIT_IS_SET(gamestate,INPUT))
+        GAME_SET(INPUT);
+        while(GAME_IS(INPUT))
         {
             new_y = receive_serial_cheat();
         }
@@ -705,14 +822,14 @@ void do_move_object(uint8_t object_mask)
         ax[1] = new_x;
         ay[1]= new_y;
         usb_serial_send("Asteroid moved\r\n");
-        asteroid_state[1] = (1<<DRAWN)|(0<<MOVING);
+        pool_set(&asteroid_pool,1,(1<<DRAWN)|(0<<MOVING));
     }
     if(object_mask == BOULDER)
     {
         boundry_check(BOULDER);
         bx[1] = new_x;
         by[1]= new_y;
-        boulder_state[1] = (1<<DRAWN)|(0<<MOVING);
+        pool_set(&boulder_pool,1,(1<<DRAWN)|(0<<MOVING));
         usb_serial_send("Boulder moved\r\n");
     }
     if(object_mask == FRAGMENT)
@@ -720,17 +837,22 @@ void do_move_object(uint8_t object_mask)
         boundry_check(FRAGMENT);
         fx[1] = new_x;
         fy[1]= new_y;
-        fragment_state[1] = (1<<DRAWN)|(0<<MOVING);
+        pool_set(&fragment_pool,1,(1<<DRAWN)|(0<<MOVING));
         usb_serial_send("Fragment moved\r\n");
     }
-    gamestate |= (1<<CHEATED) | (1<<PAUSED);
+    GAME_SET(CHEATED);
+    GAME_SET(PAUSED);
+    led_pattern_play(led_debug,LED_DEBUG_REPEATS);
     if(object_mask==SHIP)
     {
         boundry_check(SHIP);
         ship_x = new_x;
         direction = NEUTRAL;
         usb_serial_send("ship moved\r\n");
-        gamestate &= (0<<CHEATED) | (0<<PAUSED);
+        GAME_CLEAR(CHEATED);
+        GAME_CLEAR(PAUSED);
+        GAME_CLEAR(START);
+        led_pattern_stop();
     }
 }
 
@@ -745,9 +867,9 @@ void do_override(char in_char)
 {
     int override_tmp;
     usb_serial_send("Input new value: \r\n");
-    gamestate |= (1<<INPUT);
+    GAME_SET(INPUT);
 
-    while(BIT_IS_SET(gamestate,INPUT))
+    while(GAME_IS(INPUT))
     {
         override_tmp = receive_serial_cheat();
     }
@@ -770,7 +892,8 @@ void do_override(char in_char)
         game_speed = override_tmp/10;
         return_manual=0;
     }
-    gamestate |= (1<<CHEATED);
+    GAME_SET(CHEATED);
+    led_pattern_play(led_debug,LED_DEBUG_REPEATS);
 }
 
 /**
@@ -780,9 +903,9 @@ void do_override(char in_char)
 void overrride_turret()
 {
     usb_serial_send("Enter turret heading: - (-60 to 60)\r\n");
-    gamestate |= (1<<INPUT);
+    GAME_SET(INPUT);
     int tmp;
-    while(BIT_IS_SET(gamestate,INPUT))
+    while(GAME_IS(INPUT))
     {
         tmp = receive_serial_cheat();
 
@@ -798,9 +921,10 @@ void overrride_turret()
     // Sets the override timer to zero and starts the 1 seconds count
     return_manual=0;
 
-    gamestate |= (1<<PAUSED);
+    GAME_SET(PAUSED);
 }
 
+#endif
 // ----------------------------------------------------------
 
 /**
@@ -823,7 +947,7 @@ void serial_input(int16_t char_code)
     }
     if(char_code == 's')
     {
-        if(BIT_IS_SET(gamestate,PAUSED))
+        if(GAME_IS(PAUSED))
         {
             status_screen=!status_screen;
         }
@@ -835,18 +959,18 @@ void serial_input(int16_t char_code)
         {
             // If previous task was a debug cheat then reset the game in a
             // paused state and do not start.
-            if(BIT_IS_SET(gamestate,CHEATED))
+            if(GAME_IS(CHEATED))
             {
                 setup_gamestate();
-                gamestate |= (1<<PAUSED);
-                gamestate &= (0<<START);
+                GAME_SET(PAUSED);
+                GAME_CLEAR(START);
             }
             // If the gamestate START is set then the current screen has come after
             // the intro screen and the press will register as start not restart.
-            if(!BIT_IS_SET(gamestate,CHEATED) && BIT_IS_SET(gamestate,START))
+            if(!GAME_IS(CHEATED) && GAME_IS(START))
             {
-                gamestate ^= (1<<PAUSED);
-                gamestate &= (0<<START);
+                GAME_TOGGLE(PAUSED);
+                GAME_CLEAR(START);
             }
             else
             {
@@ -858,17 +982,22 @@ void serial_input(int16_t char_code)
     }
     if(char_code == 'p')
     {
-        if(BIT_IS_SET(gamestate,CHEATED))
+        // Leaving a debug cheat resets the game, paused and not started.
+        if(GAME_IS(CHEATED))
         {
             setup_gamestate();
-            gamestate &= (0<<CHEATED);
+            GAME_CLEAR(START);
+        }
+        else
+        {
+            GAME_TOGGLE(PAUSED);
         }
-        gamestate ^= (1<<PAUSED);
     }
     if(char_code == 'q')
     {
-        gamestate |= (1<<QUIT);
+        GAME_SET(QUIT);
     }
+#ifdef SERIAL_DEBUG
     if(char_code == 'o')
     {
         overrride_turret();
@@ -885,10 +1014,28 @@ void serial_input(int16_t char_code)
     {
         do_override('g');
     }
+#endif
+#ifdef PROFILER
+    if(char_code == 'b')
+    {
+        profiler_to_serial();
+    }
+    if(char_code == 'B')
+    {
+        profiler_overlay = !profiler_overlay;
+    }
+#endif
+#ifdef SCREEN_STREAM
+    if(char_code == 'v')
+    {
+        screen_stream_set_rate(screen_stream_fps ? 0 : STREAM_FPS);
+    }
+#endif
     if(char_code == '?')
     {
         //show_help();
     }
+#ifdef SERIAL_DEBUG
     if(char_code == 'h')
     {
         do_move_object(SHIP);
@@ -905,128 +1052,602 @@ void serial_input(int16_t char_code)
     {
         do_move_object(FRAGMENT);
     }
+#endif
 }
 
+#ifdef SERIAL_DEBUG
 /**
-*   Function for determining the heading needed to travel from point a to b
+*   Function for clamping a value received from the remote protocol.
+*/
+int16_t clamp_int(int16_t value, int16_t low, int16_t high)
+{
+    if(value < low)
+        return low;
+    if(value > high)
+        return high;
+    return value;
+}
+
+/**
+*   Function for setting a game parameter from a remote command, the same
+*   limits as the console overrides apply.
 *
 *   Parameters:
-*           ax: The x position of the starting point
-*           ay: The y position of the starting point
-*           bx: The x position of the finish point
-*           by: The y position of the finish point
+*           param: One of the PARAM_ values in remote.h.
+*           value: The new value.
 *
-*   Note: This is recycled code from Assignment 1
+*   Returns: 0 if param is unknown.
 */
-double get_angle(double ax,double ay,double bx,double by)
+uint8_t remote_set_param(uint8_t param, int16_t value)
 {
-    double x1 = ax-(1/2);
-    double y1 = ay-(1/2);
-    double x2 = bx-(1/2);
-    double y2 = by-(1/2);
-    double y = (y2-y1);
-    double x = (x2-x1);
-    double angle = atan2(y,x);
-    return angle;
+    if(param == PARAM_SCORE)
+        score = clamp_int(value,0,INT16_MAX);
+    else if(param == PARAM_LIVES)
+        shield_life = clamp_int(value,0,INT16_MAX);
+    else if(param == PARAM_SPEED)
+    {
+        speed_override=1;
+        game_speed = clamp_int(value,0,100)/10;
+        return_manual=0;
+    }
+    else if(param == PARAM_TURRET)
+    {
+        turret_override=1;
+        tx = clamp_int(value,-60,60)/30;
+        return_manual=0;
+    }
+    else if(param == PARAM_SHIP_X)
+    {
+        ship_x = clamp_int(value,0,LCD_X-SHIP);
+        direction = NEUTRAL;
+    }
+    else if(param == PARAM_PAUSED)
+    {
+        if(value)
+            GAME_SET(PAUSED);
+        else
+            GAME_CLEAR(PAUSED);
+        return 1;
+    }
+    else if(param == PARAM_SEED)
+    {
+        replay_seed = value;
+        return 1;
+    }
+    else if(param == PARAM_WAVE)
+        wave_number = clamp_int(value,0,255);
+#ifdef SCREEN_STREAM
+    else if(param == PARAM_STREAM_FPS)
+    {
+        screen_stream_set_rate(clamp_int(value,0,50));
+        return 1;
+    }
+#endif
+    else
+        return 0;
+
+    // Anything that changes the game counts as a cheat like the console ones.
+    GAME_SET(CHEATED);
+    led_pattern_play(led_debug,LED_DEBUG_REPEATS);
+    return 1;
 }
 
 /**
-*   Function responsible for setting the position and heading of the plasma
-*   bold when fired, it also handles sets the the state fired to true which
-*   will only be reset to 0 every 0.2 seconds giving the cannon a rate of fire
-*   of no more than 3 bolts per second.
+*   Returns the current value of a game parameter, 0 if param is unknown.
 */
-void fire_plasma_bolt()
+int16_t remote_get_param(uint8_t param)
 {
-    for(uint8_t i=0; i<MAX_PROJECTILE; i++)
+    if(param == PARAM_SCORE)
+        return score;
+    if(param == PARAM_LIVES)
+        return shield_life;
+    if(param == PARAM_SPEED)
+        return (int16_t)(game_speed*10);
+    if(param == PARAM_TURRET)
+        return (int16_t)tx*30;
+    if(param == PARAM_SHIP_X)
+        return ship_x;
+    if(param == PARAM_PAUSED)
+        return GAME_IS(PAUSED) ? 1 : 0;
+    if(param == PARAM_SEED)
+        return prng_get_seed();
+    if(param == PARAM_WAVE)
+        return wave_number;
+#ifdef SCREEN_STREAM
+    if(param == PARAM_STREAM_FPS)
+        return screen_stream_fps;
+#endif
+    return 0;
+}
+
+/**
+*   Function for placing a single object from a remote command, unlike
+*   do_move_object nothing else on the screen is reset.
+*
+*   Returns: 0 if the object or index is not valid.
+*/
+uint8_t remote_place(uint8_t object, uint8_t index, uint8_t x, uint8_t y)
+{
+    if(object == SHIP)
     {
-        if(!BIT_IS_SET(projectile_state[i],DRAWN)&&!fired)
+        ship_x = clamp_int(x,0,LCD_X-SHIP);
+        direction = NEUTRAL;
+        return 1;
+    }
+
+    x = clamp_int(x,0,LCD_X-object);
+    y = clamp_int(y,0,39-object);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(object == ASTEROID && index < MAX_ASTEROID)
+        {
+            ax[index] = x;
+            ay[index] = y;
+            pool_set(&asteroid_pool,index,(1<<DRAWN)|(0<<MOVING));
+        }
+        else if(object == BOULDER && index < MAX_BOULDER)
+        {
+            bx[index] = x;
+            by[index] = y;
+            pool_set(&boulder_pool,index,(1<<DRAWN)|(0<<MOVING));
+        }
+        else if(object == FRAGMENT && index < MAX_FRAG)
         {
-            px[i]=(ship_x+8)+tx;
-            py[i]=ty;
-            projectile_heading[i]=get_angle(ship_x+7,44, (ship_x+7)+tx, ty);
-            projectile_state[i] = (1<<DRAWN)|(1<<MOVING);
-            fired=1;
+            fx[index] = x;
+            fy[index] = y;
+            pool_set(&fragment_pool,index,(1<<DRAWN)|(0<<MOVING));
         }
+        else
+            return 0;
     }
+    GAME_SET(CHEATED);
+    GAME_SET(PAUSED);
+    led_pattern_play(led_debug,LED_DEBUG_REPEATS);
+    return 1;
 }
-// ----------------------------------------------------------
 
-// ---------------------------------------------------------
-//	Teensy input.
-// ---------------------------------------------------------
 /**
-*   Function that ties in with the previous debouncing function for the switched
-*   this handles all teensy input and assigns appropriate functions to their
-*   respective inputs.
+*   Function for running a command received through the remote protocol,
+*   see remote.h for the opcodes and their payloads.
 */
-void peripheral_input()
+uint8_t remote_command(uint8_t opcode, const uint8_t * payload, uint8_t length,
+                       uint8_t * reply, uint8_t * reply_length)
 {
-    static uint8_t joy_up_prevState = 0;
-    if(joy_up_closed != joy_up_prevState)
+    if(opcode == REMOTE_SET)
     {
-        joy_up_prevState = joy_up_closed;
-        if(joy_up_prevState==1)
+        if(length == 0 || length % 3)
+            return REMOTE_BAD_PAYLOAD;
+        for(uint8_t i=0; i<length; i+=3)
         {
-            fire_plasma_bolt();
+            if(!remote_set_param(payload[i], payload[i+1] | (payload[i+2] << 8)))
+                return REMOTE_BAD_PAYLOAD;
         }
+        return REMOTE_OK;
     }
-    static uint8_t joy_down_prevState = 0;
-    if(joy_down_closed != joy_down_prevState)
+    if(opcode == REMOTE_GET)
     {
-        joy_down_prevState = joy_down_closed;
-        if(joy_down_prevState==1)
+        if(length > (REMOTE_FRAME_MAX-4)/2)
+            return REMOTE_BAD_PAYLOAD;
+        for(uint8_t i=0; i<length; i++)
         {
-            if(BIT_IS_SET(gamestate,PAUSED))
-            {
-                status_screen=!status_screen;
-            }
-            status_to_serial();
+            int16_t value = remote_get_param(payload[i]);
+            reply[(*reply_length)++] = value & 0xFF;
+            reply[(*reply_length)++] = value >> 8;
         }
+        return REMOTE_OK;
     }
-    static uint8_t joy_left_prevState = 0;
-    if(joy_left_closed != joy_left_prevState)
+    if(opcode == REMOTE_PLACE)
     {
-        joy_left_prevState = joy_left_closed;
-        if(joy_left_prevState==1)
-        {
-            move_left();
-        }
+        if(length != 4 || !remote_place(payload[0],payload[1],payload[2],payload[3]))
+            return REMOTE_BAD_PAYLOAD;
+        return REMOTE_OK;
     }
-    static uint8_t joy_right_prevState = 0;
-    if(joy_right_closed != joy_right_prevState)
+    if(opcode == REMOTE_RESTART)
     {
-        joy_right_prevState = joy_right_closed;
-        if(joy_right_prevState==1)
-        {
-            move_right();
-        }
+        setup_gamestate();
+        return REMOTE_OK;
     }
-    static uint8_t joy_center_prevState = 0;
-    if(joy_center_closed != joy_center_prevState)
+    if(opcode == REMOTE_SNAPSHOT_SAVE || opcode == REMOTE_SNAPSHOT_LOAD)
     {
-        joy_center_prevState = joy_center_closed;
-        if(joy_center_prevState==1)
+        // The RAM snapshot is left alone while it is copied to EEPROM.
+        if(opcode == REMOTE_SNAPSHOT_SAVE && snapshot_store_left())
+            return REMOTE_BUSY;
+        uint16_t size = snapshot_game(opcode == REMOTE_SNAPSHOT_SAVE ? SNAPSHOT_SAVE : SNAPSHOT_LOAD);
+        if(!size)
+            return REMOTE_BAD_PAYLOAD;
+        reply[(*reply_length)++] = size & 0xFF;
+        reply[(*reply_length)++] = size >> 8;
+        return REMOTE_OK;
+    }
+    if(opcode == REMOTE_SNAPSHOT_READ)
+    {
+        if(length != 3 || payload[2] > REMOTE_SNAPSHOT_CHUNK)
+            return REMOTE_BAD_PAYLOAD;
+        *reply_length = snapshot_read(payload[0] | (payload[1] << 8), reply, payload[2]);
+        return REMOTE_OK;
+    }
+    if(opcode == REMOTE_SNAPSHOT_WRITE)
+    {
+        if(snapshot_store_left())
+            return REMOTE_BUSY;
+        if(length < 3 || snapshot_write(payload[0] | (payload[1] << 8), &payload[2], length-2) != length-2)
+            return REMOTE_BAD_PAYLOAD;
+        return REMOTE_OK;
+    }
+    if(opcode == REMOTE_SNAPSHOT_STORE)
+    {
+        if(length > 1 || (length && payload[0] != 1))
+            return REMOTE_BAD_PAYLOAD;
+        if(length)
         {
-            gamestate ^= (1<<PAUSED);
+            if(snapshot_store_left())
+                return REMOTE_BUSY;
+            if(!snapshot_store_start())
+                return REMOTE_BAD_PAYLOAD;
         }
+        uint16_t left = snapshot_store_left();
+        reply[(*reply_length)++] = left & 0xFF;
+        reply[(*reply_length)++] = left >> 8;
+        return REMOTE_OK;
     }
-    static uint8_t SW1_prevState = 0;
-    if(SW1_closed != SW1_prevState)
+    if(opcode == REMOTE_SNAPSHOT_FETCH)
     {
-        SW1_prevState = SW1_closed;
-        if(SW1_prevState==1)
-        {
-            if(!intro_screen)
-            {
-                if(BIT_IS_SET(gamestate,CHEATED))
-                {
-                    setup_gamestate();
-                }
-                if(BIT_IS_SET(gamestate,START) && !BIT_IS_SET(gamestate,CHEATED))
+        if(snapshot_store_left())
+            return REMOTE_BUSY;
+        uint16_t size = snapshot_fetch();
+        if(!size)
+            return REMOTE_BAD_PAYLOAD;
+        reply[(*reply_length)++] = size & 0xFF;
+        reply[(*reply_length)++] = size >> 8;
+        return REMOTE_OK;
+    }
+    if(opcode == REMOTE_THROUGHPUT)
+    {
+        // The screen stream would share the port with the test.
+        if(throughput_active() || screen_stream_running())
+            return REMOTE_BUSY;
+        if(length != 2 || !throughput_start(payload[0], payload[1]))
+            return REMOTE_BAD_PAYLOAD;
+        return REMOTE_OK;
+    }
+    if(opcode == REMOTE_THROUGHPUT_RESULT)
+    {
+        *reply_length = throughput_result(reply);
+        return *reply_length ? REMOTE_OK : REMOTE_BUSY;
+    }
+    return REMOTE_BAD_OPCODE;
+}
+
+// ---------------------------------------------------------
+//	Snapshots
+// ---------------------------------------------------------
+
+// A snapshot only loads into a build with the same pool sizes.
+#define SNAPSHOT_LAYOUT ((uint16_t)((MAX_ASTEROID << 8) | MAX_PROJECTILE))
+
+/**
+*   Function for saving or loading one pool of objects, a bit mask of the
+*   slots in use is stored for every 8 slots followed by only those slots.
+*
+*   Parameters:
+*           size: The number of slots in the pool.
+*           pool_y: Where unused slots are parked when loading.
+*/
+void snapshot_pool(uint8_t size, pool_t * pool, double x[], double y[],
+                   double dx[], double dy[], int tick[], double pool_y)
+{
+    for(uint8_t first=0; first<size; first+=8)
+    {
+        uint8_t used=0;
+        for(uint8_t i=0; i<8 && first+i<size; i++)
+        {
+            if(pool_get(pool,first+i))
+                used |= (1<<i);
+        }
+        snapshot_u8(&used);
+
+        for(uint8_t i=0; i<8 && first+i<size; i++)
+        {
+            uint8_t slot = first+i;
+            if(used & (1<<i))
+            {
+                uint8_t state = pool_get(pool,slot);
+                snapshot_u8(&state);
+                pool_set(pool,slot,state);
+                snapshot_q16(&x[slot],8);
+                snapshot_q16(&y[slot],8);
+                snapshot_q16(&dx[slot],12);
+                snapshot_q16(&dy[slot],12);
+                snapshot_int(&tick[slot]);
+            }
+            else if(snapshot_loading())
+            {
+                pool_set(pool,slot,0);
+                y[slot]=pool_y;
+            }
+        }
+    }
+}
+
+/**
+*   Function for saving the whole game to the RAM snapshot or loading it
+*   back, the same list of fields is walked either way so the two can never
+*   disagree. Bump SNAPSHOT_VERSION and SNAPSHOT_SIZE_MAX when the list
+*   changes.
+*
+*   Parameters:
+*           mode: SNAPSHOT_SAVE or SNAPSHOT_LOAD.
+*
+*   Return: The size of the snapshot in bytes, 0 if it could not be saved or
+*           there is no valid snapshot to load.
+*
+*   Note: The Timer0 game update is held off for the pass, which only
+*         touches RAM. Copying the snapshot to EEPROM is a separate step
+*         (snapshot_store_start) that runs a byte a frame.
+*/
+uint16_t snapshot_game(uint8_t mode)
+{
+    uint16_t prng[PRNG_STREAMS+1];
+    uint8_t flags;
+    uint16_t length;
+
+    if(mode == SNAPSHOT_LOAD && !snapshot_check(SNAPSHOT_LAYOUT))
+        return 0;
+
+    game_frozen=1;
+    snapshot_begin(mode);
+
+    snapshot_u8(&gamestate);
+    snapshot_u8(&game_over_state);
+    snapshot_u8(&direction);
+    snapshot_u8(&ship_x);
+    snapshot_u8(&ship_tick);
+    snapshot_u8(&ship_speed);
+    snapshot_u8(&wave_started);
+    snapshot_u8(&count);
+    snapshot_u8(&wave_number);
+    snapshot_u8(&ship_invulnerable);
+    snapshot_u8(&wave_speed);
+
+    flags = (intro_screen!=0) | ((status_screen!=0)<<1) | ((turret_override!=0)<<2)
+            | ((speed_override!=0)<<3) | ((fired!=0)<<4);
+    snapshot_u8(&flags);
+
+    snapshot_int(&score);
+    snapshot_int(&shield_life);
+    snapshot_u16(&replay_seed);
+
+    snapshot_q16(&tx,8);
+    snapshot_q16(&game_speed,8);
+    snapshot_q16(&spawn_delay,8);
+    snapshot_q16(&wave_time,8);
+    snapshot_q16(&return_manual,8);
+    snapshot_q16(&fireTimer,8);
+    snapshot_q16(&rand_delay,8);
+    snapshot_q32(&game_time);
+
+    for(uint8_t i=0; i<MAX_ASTEROID; i++)
+    {
+        snapshot_u8(&array_pos[i]);
+    }
+
+    prng_get_state(prng);
+    for(uint8_t i=0; i<=PRNG_STREAMS; i++)
+    {
+        snapshot_u16(&prng[i]);
+    }
+
+    // Asteroids are all kept as the waiting ones hold their lane position.
+    for(uint8_t i=0; i<MAX_ASTEROID; i++)
+    {
+        uint8_t state = pool_get(&asteroid_pool,i);
+        snapshot_u8(&state);
+        pool_set(&asteroid_pool,i,state);
+        snapshot_q16(&ax[i],8);
+        snapshot_q16(&ay[i],8);
+        snapshot_int(&asteroid_tick[i]);
+    }
+    snapshot_pool(MAX_BOULDER,&boulder_pool,bx,by,bdx,bdy,boulder_tick,POOL_COORDINATES);
+    snapshot_pool(MAX_FRAG,&fragment_pool,fx,fy,fdx,fdy,fragment_tick,POOL_COORDINATES);
+    snapshot_pool(MAX_PROJECTILE,&projectile_pool,px,py,pdx,pdy,projectile_tick,PROJECTILE_POOL);
+    for(uint8_t i=0; i<MAX_PROJECTILE; i++)
+    {
+        if(pool_get(&projectile_pool,i))
+            snapshot_q16(&projectile_heading[i],12);
+    }
+
+    length = snapshot_end(SNAPSHOT_LAYOUT);
+
+    if(mode == SNAPSHOT_LOAD)
+    {
+        intro_screen = flags & 0x01;
+        status_screen = (flags >> 1) & 0x01;
+        turret_override = (flags >> 2) & 0x01;
+        speed_override = (flags >> 3) & 0x01;
+        fired = (flags >> 4) & 0x01;
+        prng_set_state(prng);
+
+        // The wave table entry is looked up again rather than stored.
+        wave_load(wave_number ? wave_number-1 : 0, &wave);
+        if(wave.asteroids > MAX_ASTEROID)
+            wave.asteroids = MAX_ASTEROID;
+
+        if(GAME_IS(CHEATED))
+            led_pattern_play(led_debug,LED_DEBUG_REPEATS);
+        else
+            led_pattern_stop();
+    }
+    game_frozen=0;
+    return length;
+}
+#endif
+
+/**
+*   Function for determining the heading needed to travel from point a to b
+*
+*   Parameters:
+*           ax: The x position of the starting point
+*           ay: The y position of the starting point
+*           bx: The x position of the finish point
+*           by: The y position of the finish point
+*
+*   Note: This is recycled code from Assignment 1
+*/
+double get_angle(double ax,double ay,double bx,double by)
+{
+    double x1 = ax-(1/2);
+    double y1 = ay-(1/2);
+    double x2 = bx-(1/2);
+    double y2 = by-(1/2);
+    double y = (y2-y1);
+    double x = (x2-x1);
+    double angle = atan2(y,x);
+    return angle;
+}
+
+/**
+*   Function for taking a free projectile slot, when the pool is exhausted
+*   PROJECTILE_POLICY decides whether the oldest bolt gives up its slot.
+*
+*   Return: The slot index, POOL_NONE if no slot could be taken.
+*
+*   Note: A free slot is found with a single find first clear on the DRAWN
+*         bitset, only recycling looks at every slot and only when all of
+*         them are in flight.
+*/
+uint8_t projectile_alloc()
+{
+    uint8_t slot = pool_first_clear(&projectile_pool,MAX_PROJECTILE,DRAWN);
+#if PROJECTILE_POLICY == PROJECTILE_RECYCLE
+    if(slot==POOL_NONE)
+    {
+        uint8_t oldest = 0;
+        slot = 0;
+        for(uint8_t i=0; i<MAX_PROJECTILE; i++)
+        {
+            uint8_t age = projectile_shots - projectile_shot[i];
+            if(age > oldest)
+            {
+                oldest = age;
+                slot = i;
+            }
+        }
+        projectile_tick[slot] = 0;
+    }
+    projectile_shot[slot] = projectile_shots++;
+#endif
+    return slot;
+}
+
+/**
+*   Function responsible for setting the position and heading of the plasma
+*   bold when fired, it also handles sets the the state fired to true which
+*   will only be reset to 0 every 0.2 seconds giving the cannon a rate of fire
+*   of no more than 3 bolts per second.
+*
+*   Return: The projectile slot used, POOL_NONE if no bolt was fired.
+*/
+uint8_t fire_plasma_bolt()
+{
+    if(fired)
+        return POOL_NONE;
+    uint8_t i = projectile_alloc();
+    if(i==POOL_NONE)
+        return POOL_NONE;
+    px[i]=(ship_x+8)+tx;
+    py[i]=ty;
+    projectile_heading[i]=get_angle(ship_x+7,44, (ship_x+7)+tx, ty);
+    pdx[i]=pdy[i]=0;
+    pool_set(&projectile_pool,i,(1<<DRAWN)|(1<<MOVING));
+    fired=1;
+    return i;
+}
+// ----------------------------------------------------------
+
+// ---------------------------------------------------------
+//	Teensy input.
+// ---------------------------------------------------------
+/**
+*   Function that ties in with the previous debouncing function for the switched
+*   this handles all teensy input and assigns appropriate functions to their
+*   respective inputs.
+*/
+void peripheral_input()
+{
+    static uint8_t joy_up_prevState = 0;
+    if(joy_up_closed != joy_up_prevState)
+    {
+        joy_up_prevState = joy_up_closed;
+        if(joy_up_prevState==1)
+        {
+            fire_plasma_bolt();
+        }
+    }
+    static uint8_t joy_down_prevState = 0;
+    if(joy_down_closed != joy_down_prevState)
+    {
+        joy_down_prevState = joy_down_closed;
+        if(joy_down_prevState==1)
+        {
+            if(GAME_IS(PAUSED))
+            {
+                status_screen=!status_screen;
+            }
+            status_to_serial();
+        }
+    }
+    static uint8_t joy_left_prevState = 0;
+    if(joy_left_closed != joy_left_prevState)
+    {
+        joy_left_prevState = joy_left_closed;
+        if(joy_left_prevState==1)
+        {
+            move_left();
+        }
+    }
+    static uint8_t joy_right_prevState = 0;
+    if(joy_right_closed != joy_right_prevState)
+    {
+        joy_right_prevState = joy_right_closed;
+        if(joy_right_prevState==1)
+        {
+            move_right();
+        }
+    }
+    static uint8_t joy_center_prevState = 0;
+    if(joy_center_closed != joy_center_prevState)
+    {
+        joy_center_prevState = joy_center_closed;
+        if(joy_center_prevState==1)
+        {
+            // While the game over sequence is running the press skips
+            // straight to the restart/quit choices.
+            if(game_over_state==GO_DIM || game_over_state==GO_MESSAGE)
+            {
+                game_over_finish();
+            }
+            else
+            {
+                GAME_TOGGLE(PAUSED);
+            }
+        }
+    }
+    static uint8_t SW1_prevState = 0;
+    if(SW1_closed != SW1_prevState)
+    {
+        SW1_prevState = SW1_closed;
+        if(SW1_prevState==1)
+        {
+            if(!intro_screen)
+            {
+                if(GAME_IS(CHEATED))
                 {
-                    gamestate ^= (1<<PAUSED);
-                    gamestate &= (0<<START);
+                    setup_gamestate();
+                }
+                if(GAME_IS(START) && !GAME_IS(CHEATED))
+                {
+                    GAME_TOGGLE(PAUSED);
+                    GAME_CLEAR(START);
                 }
                 else
                 {
@@ -1044,7 +1665,7 @@ void peripheral_input()
         if(SW2_prevState==1)
         {
             usb_serial_send("SW2 - quit \r\n");
-            gamestate |= (1<<QUIT);
+            GAME_SET(QUIT);
         }
     }
 }
@@ -1095,6 +1716,11 @@ uint8_t fragment[8] =
 };
 uint8_t fragment_direct[8];
 
+// Collision masks of the rock sprites, see collide.h.
+uint8_t asteroid_mask[COLLIDE_MASK_MAX];
+uint8_t boulder_mask[COLLIDE_MASK_MAX];
+uint8_t fragment_mask[COLLIDE_MASK_MAX];
+
 /**
 *   Function to setup the images flipping them around so that when used in
 *   a for loop with WRITE_BIT to draw to screen everything is oriented the
@@ -1134,6 +1760,74 @@ void format_images()
             WRITE_BIT(fragment_direct[i], j, bit_val);
         }
     }
+    collide_build_mask(asteroid,ASTEROID,asteroid_mask);
+    collide_build_mask(boulder,BOULDER,boulder_mask);
+    collide_build_mask(fragment,FRAGMENT,fragment_mask);
+}
+
+// The left pot gives a turret x offset of TURRET_MIN to TURRET_MIN+TURRET_ANGLES-1
+#define TURRET_MIN -3
+#define TURRET_ANGLES 7
+// The turret can reach 3 columns past the right of the 9 pixel wide ship
+#define SHIP_SPRITE_WIDTH 12
+// First column of the ship sprite the turret can touch
+#define TURRET_FIRST_COLUMN 4
+
+// Column masks of the two turret lines, (ship_x+7,44) and (ship_x+8,44) to
+// (..+tx,41), for each turret offset, covering columns 4 to 11 of the ship
+// sprite with bit 0 as y=41. These are the pixels draw_line picked.
+const uint8_t turret_masks[TURRET_ANGLES][SHIP_SPRITE_WIDTH-TURRET_FIRST_COLUMN] PROGMEM =
+{
+    {0x01, 0x03, 0x06, 0x0C, 0x08, 0x00, 0x00, 0x00},
+    {0x00, 0x01, 0x07, 0x0E, 0x08, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x03, 0x0F, 0x0C, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x0F, 0x0F, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x0C, 0x0F, 0x03, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x08, 0x0E, 0x07, 0x01, 0x00},
+    {0x00, 0x00, 0x00, 0x08, 0x0C, 0x06, 0x03, 0x01}
+};
+
+// Ship and turret combined for the current turret offset, rebuilt only when
+// the offset changes so a frame is a single blit.
+uint8_t ship_sprite[SHIP_SPRITE_WIDTH];
+uint8_t ship_sprite_width=9;
+uint8_t ship_sprite_angle=0xFF;
+
+// A rock reaching the barrier over the ship also hits the ship and takes
+// SHIP_HIT_DAMAGE more shield life, the ship then blinks and cannot be hit
+// again for SHIP_INVULNERABLE_FRAMES frames.
+#define SHIP_HIT_DAMAGE 1
+#define SHIP_INVULNERABLE_FRAMES 40
+#define SHIP_BLINK 0x04
+uint8_t ship_zone[COLLIDE_ZONE_BYTES];
+
+/**
+*   Function for bringing the combined ship and turret sprite up to date with
+*   the turret offset, the offset is clamped to the range of the mask table.
+*/
+void update_ship_sprite()
+{
+    int8_t offset = (int8_t)tx;
+    if(offset < TURRET_MIN)
+        offset = TURRET_MIN;
+    if(offset > TURRET_MIN+TURRET_ANGLES-1)
+        offset = TURRET_MIN+TURRET_ANGLES-1;
+    uint8_t angle = offset - TURRET_MIN;
+
+    if(angle == ship_sprite_angle)
+        return;
+    ship_sprite_angle = angle;
+    ship_sprite_width = 0;
+
+    for(uint8_t i=0; i<SHIP_SPRITE_WIDTH; i++)
+    {
+        uint8_t column = i<8 ? ship_direct[i] : 0;
+        if(i >= TURRET_FIRST_COLUMN)
+            column |= pgm_read_byte(&turret_masks[angle][i-TURRET_FIRST_COLUMN]);
+        ship_sprite[i] = column;
+        if(column)
+            ship_sprite_width = i+1;
+    }
 }
 
 /**
@@ -1144,14 +1838,41 @@ void format_images()
 */
 void setup_asteroid(uint8_t i)
 {
-    //Split the screen into thirds and grab the rand range for each asteroid
-    uint8_t upper = (uint8_t)((i+1) * 24);
-    uint8_t lower = (uint8_t)(i* (LCD_X /3));
-    ax[i]= (rand() % (upper - lower + 1)) + lower;
+    //Split the screen into a lane per asteroid and grab the rand range for each asteroid
+    uint8_t upper = (uint8_t)((i+1) * (LCD_X-ASTEROID) / MAX_ASTEROID);
+    uint8_t lower = (uint8_t)(i * (LCD_X-ASTEROID) / MAX_ASTEROID);
+    ax[i]= prng_range(PRNG_SPAWN, upper - lower + 1) + lower;
 
-    asteroid_state[i] = (0<<DRAWN) | (0<<MOVING);
+    pool_set(&asteroid_pool,i,(0<<DRAWN) | (0<<MOVING));
 }
 
+// Split velocities in 1/64ths of a pixel per step, each pair is the dx and
+// dy of a child heading between 60 and 90 degrees (0.8 * cos(heading)) with
+// a fall speed between 0.2 and 1.5. The second child mirrors dx so the two
+// children always head away from each other like the 60-90 and 90-120
+// degree ranges they replace.
+#define SPLIT_VELOCITIES 16
+#define SPLIT_SCALE (1.0/64)
+const int8_t split_velocity[SPLIT_VELOCITIES][2] PROGMEM =
+{
+    { 26,  13}, // 60 deg, dy 0.20
+    { 24,  52}, // 62 deg, dy 0.81
+    { 22,  90}, // 64 deg, dy 1.41
+    { 21,  41}, // 66 deg, dy 0.63
+    { 19,  79}, // 68 deg, dy 1.24
+    { 18,  29}, // 70 deg, dy 0.46
+    { 16,  68}, // 72 deg, dy 1.07
+    { 14,  18}, // 74 deg, dy 0.29
+    { 12,  57}, // 76 deg, dy 0.89
+    { 11,  96}, // 78 deg, dy 1.50
+    {  9,  46}, // 80 deg, dy 0.72
+    {  7,  85}, // 82 deg, dy 1.33
+    {  5,  35}, // 84 deg, dy 0.55
+    {  4,  74}, // 86 deg, dy 1.15
+    {  2,  24}, // 88 deg, dy 0.37
+    {  0,  63}  // 90 deg, dy 0.98
+};
+
 /**
 *   Function for setting up any child objects of destroyed parent objects.
 *
@@ -1190,18 +1911,18 @@ void setup_asteroid(uint8_t i)
 */
 void setup_child_object(int i, double x[], double y[], double dx[], double dy[], double px, double py)
 {
-    // Seeings that the heading is clamped between 60-90 and 90-120 it is safe to use
-    // a uint8_t in place of an int to save some space.
-    uint8_t randHead1 = rand()%(90-60 +1)+60;
-    uint8_t randHead2 = rand()%(120 - 90 +1)+90;
+    // One random value picks a table entry for each child.
+    uint16_t pick = prng_next(PRNG_SPLIT);
+    uint8_t left = pick & (SPLIT_VELOCITIES-1);
+    uint8_t right = (pick >> 8) & (SPLIT_VELOCITIES-1);
     y[i]= py;
     y[i+1]= py;
     x[i]= px;
     x[i+1] = px;
-    dy[i] = (double)(rand()% (15-2 +1)+2)/10;
-    dy[i+1] = (double)(rand()% (15-2 +1)+2)/10;
-    dx[i] = 0.8 * cos(randHead2);
-    dx[i+1] = 0.8 * cos(randHead1);
+    dy[i] = (int8_t)pgm_read_byte(&split_velocity[left][1]) * SPLIT_SCALE;
+    dy[i+1] = (int8_t)pgm_read_byte(&split_velocity[right][1]) * SPLIT_SCALE;
+    dx[i] = -(int8_t)pgm_read_byte(&split_velocity[left][0]) * SPLIT_SCALE;
+    dx[i+1] = (int8_t)pgm_read_byte(&split_velocity[right][0]) * SPLIT_SCALE;
 }
 
 /**
@@ -1218,6 +1939,7 @@ void setup_images(void)
 {
     format_images();
     count = 0;
+    ship_invulnerable=0;
     wave_started=0;
     for(uint8_t j=0; j<MAX_ASTEROID; j++)
     {
@@ -1227,24 +1949,23 @@ void setup_images(void)
     for(uint8_t y =0; y<MAX_ASTEROID; y++)
     {
         ay[y]=POOL_COORDINATES;
-        asteroid_state[y]=0;
     }
     for(uint8_t k=0; k<MAX_BOULDER; k++)
     {
         by[k]=POOL_COORDINATES;
-        boulder_state[k]=0;
     }
     for(uint8_t f =0; f<MAX_FRAG; f++)
     {
         fy[f]=POOL_COORDINATES;
-        fragment_state[f]=0;
     }
     for(uint8_t i=0; i<MAX_PROJECTILE; i++)
     {
         py[i]=PROJECTILE_POOL;
-        projectile_state[i]=0;
     }
-
+    pool_clear(&asteroid_pool);
+    pool_clear(&boulder_pool);
+    pool_clear(&fragment_pool);
+    pool_clear(&projectile_pool);
 }
 
 /**
@@ -1277,17 +1998,7 @@ void draw_object(int top_left_x, int top_left_y, uint8_t pixels[], int width, in
 */
 void draw_barrier()
 {
-    for(int i=0; i<84; i++)
-    {
-        if(i%2==0)
-        {
-            draw_pixel(i,39,FG_COLOUR);
-        }
-        else
-        {
-            draw_pixel(i,39,BG_COLOUR);
-        }
-    }
+    fb_pattern_row(0,39,LCD_X,FB_DOTTED);
 }
 
 /**
@@ -1320,15 +2031,21 @@ void draw_projectile(int i)
 {
     // Cheat flag is used to allow the ship to fire while paused only if
     // a debug input has been used.
-    if(!BIT_IS_SET(gamestate,PAUSED)|| BIT_IS_SET(gamestate,CHEATED))
+    if(!GAME_IS(PAUSED)|| GAME_IS(CHEATED))
     {
         projectile_tick[i]++;
         if(projectile_tick[i]*ship_speed>10)
         {
-            if(BIT_IS_SET(projectile_state[i],MOVING))
+            if(pool_is(&projectile_pool,i,MOVING))
             {
+#ifdef FIXED_MATH
+                uint16_t angle = TRIG_ANGLE(projectile_heading[i]);
+                pdx[i]=trig_cos(angle)/(double)TRIG_ONE;
+                pdy[i]=trig_sin(angle)/(double)TRIG_ONE;
+#else
                 pdx[i]=cos(projectile_heading[i]);
                 pdy[i]=sin(projectile_heading[i]);
+#endif
                 py[i] += pdy[i];
                 px[i] += pdx[i];
             }
@@ -1336,11 +2053,11 @@ void draw_projectile(int i)
         }
         if(py[i] < 0 || px[i] > 84 || px[i] < 0)
         {
-            projectile_state[i] = (0<<DRAWN) | (0<<MOVING);
+            pool_set(&projectile_pool,i,(0<<DRAWN) | (0<<MOVING));
         }
     }
 
-    if(BIT_IS_SET(projectile_state[i],DRAWN))
+    if(pool_is(&projectile_pool,i,DRAWN))
     {
         for(uint8_t j =0; j<2; j++)
         {
@@ -1352,6 +2069,89 @@ void draw_projectile(int i)
     }
 }
 
+/**
+*   Function for sweeping every bolt in flight against a falling object and
+*   removing the ones that hit it.
+*
+*   Parameters:
+*           x, y: The position of the object.
+*           dx, dy: How far the object moved this frame, 0 if it did not move.
+*           mask: The collision mask of the object sprite.
+*           size: The width of the object.
+*
+*   Return: The number of bolts that hit the object.
+*
+*   Note: Objects are moved and tested before the bolts are moved, so each
+*         bolt is swept over the step it took last frame, which is still in
+*         pdx and pdy while its tick is 0. Positions are floored before they
+*         are compared so the test matches the pixels as drawn.
+*/
+uint8_t projectile_hits(double x, double y, double dx, double dy, const uint8_t * mask, uint8_t size)
+{
+    uint8_t hits = 0;
+    uint8_t running = !GAME_IS(PAUSED)|| GAME_IS(CHEATED);
+    fix_t ox = FIX_FLOOR(TO_FIX(x)), oy = FIX_FLOOR(TO_FIX(y)), odx = 0, ody = 0;
+    if(running)
+    {
+        odx = TO_FIX(dx);
+        ody = TO_FIX(dy);
+    }
+
+    for(uint8_t j=0; j<MAX_PROJECTILE; j++)
+    {
+        if(!pool_is(&projectile_pool,j,DRAWN))
+            continue;
+        fix_t pdx_fix = 0, pdy_fix = 0;
+        if(running && projectile_tick[j]==0 && pool_is(&projectile_pool,j,MOVING))
+        {
+            pdx_fix = TO_FIX(pdx[j]);
+            pdy_fix = TO_FIX(pdy[j]);
+        }
+        if(collide_sprite(FIX_FLOOR(TO_FIX(px[j]))-ox, FIX_FLOOR(TO_FIX(py[j]))-oy,
+                          pdx_fix-odx, pdy_fix-ody, mask, size))
+        {
+            px[j]=py[j]= PROJECTILE_POOL;
+            pool_set(&projectile_pool,j,(0<<DRAWN) | (0<<MOVING));
+            hits++;
+        }
+    }
+    return hits;
+}
+
+// Cycles spent on the ship hit test, reported by the rocks scenes of the
+// benchmark build.
+#ifdef BENCHMARK
+uint32_t bench_ship_cycles;
+#define BENCH_SHIP_START() uint32_t bench_ship_start = profiler_now()
+#define BENCH_SHIP_END() bench_ship_cycles += profiler_now() - bench_ship_start
+#else
+#define BENCH_SHIP_START()
+#define BENCH_SHIP_END()
+#endif
+
+/**
+*   Function for checking whether a rock that reached the barrier came down
+*   on the ship.
+*
+*   Parameters:
+*           x: The x position of the rock.
+*           size: The width of the rock.
+*
+*   Note: The ship zone is rebuilt once a frame and this only runs when a
+*         rock reaches the barrier, so the cost does not grow with the
+*         number of rocks in play.
+*/
+void ship_hit_check(double x, uint8_t size)
+{
+    BENCH_SHIP_START();
+    if(!ship_invulnerable && collide_zone_hit(ship_zone,(int16_t)x,size))
+    {
+        shield_life -= SHIP_HIT_DAMAGE;
+        ship_invulnerable = SHIP_INVULNERABLE_FRAMES;
+    }
+    BENCH_SHIP_END();
+}
+
 /**
 *   Function responsible for the moving and setting fragment state
 *   also detects collisions with projectiles.
@@ -1368,12 +2168,12 @@ void draw_projectile(int i)
 */
 void draw_fragment(int i)
 {
-    if(!BIT_IS_SET(gamestate,PAUSED)|| BIT_IS_SET(gamestate,CHEATED))
+    if(!GAME_IS(PAUSED)|| GAME_IS(CHEATED))
     {
         fragment_tick[i]++;
-        if(fragment_tick[i]*game_speed>10)
+        if(fragment_tick[i]*game_speed*wave_speed>100)
         {
-            if(BIT_IS_SET(fragment_state[i],MOVING))
+            if(pool_is(&fragment_pool,i,MOVING))
             {
                 bounce(i,fx,fdx);
                 fy[i] += fdy[i];
@@ -1384,31 +2184,32 @@ void draw_fragment(int i)
     }
 
     // Check if any projectiles have collided
-    for(uint8_t j=0; j<MAX_PROJECTILE; j++)
+    if(fy[i]>0)
     {
-        if(px[j] >= fx[i] && px[j] <= fx[i]+3 && py[j] >= by[i] && py[j] <= fy[i]+3&& fy[i]>0)
+        uint8_t moved = fragment_tick[i]==0 && pool_is(&fragment_pool,i,MOVING);
+        uint8_t hits = projectile_hits(fx[i],fy[i],moved ? fdx[i] : 0,moved ? fdy[i] : 0,fragment_mask,FRAGMENT);
+        if(hits)
         {
-            fragment_state[i] = (1<<BROKEN);
-            px[j]=py[j]= PROJECTILE_POOL;
-            projectile_state[j] = (0<<DRAWN) | (0<<MOVING);
-            score += 4;
+            pool_set(&fragment_pool,i,(1<<BROKEN));
+            score += 4*hits;
         }
     }
 
     // If collided with shield or projectile turn off and move to pool
-    if(fy[i]>39-3 || BIT_IS_SET(fragment_state[i],BROKEN))
+    if(fy[i]>39-3 || pool_is(&fragment_pool,i,BROKEN))
     {
         // If collided with shield reduce shield life
         if(fy[i]>39-3)
         {
             shield_life--;
+            ship_hit_check(fx[i],FRAGMENT);
         }
 
         fy[i]=-10;
-        fragment_state[i] = (0<<MOVING)|(0<<DRAWN);
+        pool_set(&fragment_pool,i,(0<<MOVING)|(0<<DRAWN));
     }
 
-    if(!BIT_IS_SET(fragment_state[i],BROKEN))
+    if(!pool_is(&fragment_pool,i,BROKEN))
     {
         draw_object(fx[i],fy[i],fragment_direct,3,3);
     }
@@ -1433,12 +2234,12 @@ void draw_fragment(int i)
 */
 void draw_boulder(int i)
 {
-    if(!BIT_IS_SET(gamestate,PAUSED)|| BIT_IS_SET(gamestate,CHEATED))
+    if(!GAME_IS(PAUSED)|| GAME_IS(CHEATED))
     {
         boulder_tick[i]++;
-        if(boulder_tick[i]*game_speed>10)
+        if(boulder_tick[i]*game_speed*wave_speed>100)
         {
-            if(BIT_IS_SET(boulder_state[i],MOVING))
+            if(pool_is(&boulder_pool,i,MOVING))
             {
                 bounce(i,bx,bdx);
                 by[i] += bdy[i];
@@ -1450,42 +2251,43 @@ void draw_boulder(int i)
     }
 
     // Check if any projectiles have collided
-    for(uint8_t j=0; j<MAX_PROJECTILE; j++)
+    if(by[i]>0)
     {
-        if(((px[j] >= bx[i] && px[j] <= bx[i]+5) && (py[j] >= by[i] && py[j] <= by[i]+5))&& by[i]>0)
+        uint8_t moved = boulder_tick[i]==0 && pool_is(&boulder_pool,i,MOVING);
+        uint8_t hits = projectile_hits(bx[i],by[i],moved ? bdx[i] : 0,moved ? bdy[i] : 0,boulder_mask,BOULDER);
+        if(hits)
         {
-            boulder_state[i] = (1<<BROKEN);
-            px[j]=py[j]= PROJECTILE_POOL;
-            projectile_state[j] = (0<<DRAWN) | (0<<MOVING);
-            score += 2;
+            pool_set(&boulder_pool,i,(1<<BROKEN));
+            score += 2*hits;
         }
     }
 
     // If collided with shield or projectile turn off and move to pool
-    if(by[i]>39-5 ||BIT_IS_SET(boulder_state[i],BROKEN))
+    if(by[i]>39-5 ||pool_is(&boulder_pool,i,BROKEN))
     {
 
         // If collided with projectile set up child objects.
-        if(BIT_IS_SET(boulder_state[i],BROKEN))
+        if(pool_is(&boulder_pool,i,BROKEN))
         {
             setup_child_object((i*2),fx,fy,fdx,fdy,bx[i],by[i]);
-            fragment_state[i*2] = (0<<BROKEN)|(1<<DRAWN)|(1<<MOVING);
-            fragment_state[(i*2)+1] =(0<<BROKEN)|(1<<DRAWN)|(1<<MOVING);
-            boulder_state[i] = (0<<BROKEN);
+            pool_set(&fragment_pool,i*2,(0<<BROKEN)|(1<<DRAWN)|(1<<MOVING));
+            pool_set(&fragment_pool,(i*2)+1,(0<<BROKEN)|(1<<DRAWN)|(1<<MOVING));
+            pool_set(&boulder_pool,i,(0<<BROKEN));
         }
         // If collided with shield reduce shield life
         if(by[i]>39-5)
         {
             shield_life--;
+            ship_hit_check(bx[i],BOULDER);
         }
 
         by[i]=-10;
 
-        boulder_state[i] = (0<<MOVING) | (0<<DRAWN);
+        pool_set(&boulder_pool,i,(0<<MOVING) | (0<<DRAWN));
 
     }
 
-    if(!BIT_IS_SET(boulder_state[i],BROKEN))
+    if(!pool_is(&boulder_pool,i,BROKEN))
     {
         draw_object(bx[i],by[i],boulder_direct,5,5);
     }
@@ -1510,12 +2312,12 @@ void draw_boulder(int i)
 void draw_asteroid(int i)
 {
 
-    if(!BIT_IS_SET(gamestate,PAUSED)|| BIT_IS_SET(gamestate,CHEATED))
+    if(!GAME_IS(PAUSED)|| GAME_IS(CHEATED))
     {
         asteroid_tick[i]++;
-        if(asteroid_tick[i]*game_speed>10)
+        if(asteroid_tick[i]*game_speed*wave_speed>100)
         {
-            if(BIT_IS_SET(asteroid_state[i],MOVING))
+            if(pool_is(&asteroid_pool,i,MOVING))
             {
                 ay[i]++;
             }
@@ -1524,42 +2326,43 @@ void draw_asteroid(int i)
     }
 
     // If collided with projectile set up child objects.
-    for(uint8_t j=0; j<MAX_PROJECTILE; j++)
+    if(ay[i]>0)
     {
-        if(px[j] >= ax[i] && px[j] <= ax[i]+7 && py[j] >= ay[i] && py[j] <= ay[i]+7&& ay[i]>0)
+        uint8_t moved = asteroid_tick[i]==0 && pool_is(&asteroid_pool,i,MOVING);
+        uint8_t hits = projectile_hits(ax[i],ay[i],0,moved ? 1 : 0,asteroid_mask,ASTEROID);
+        if(hits)
         {
-            asteroid_state[i] = (1<<BROKEN);
-            px[j]=py[j]= PROJECTILE_POOL;
-            projectile_state[j] = (0<<DRAWN) | (0<<MOVING);
-            score += 1;
+            pool_set(&asteroid_pool,i,(1<<BROKEN));
+            score += hits;
         }
     }
 
     // If collided with shield or projectile turn off and move to pool
-    if(ay[i]>39-7 ||BIT_IS_SET(asteroid_state[i],BROKEN))
+    if(ay[i]>39-7 ||pool_is(&asteroid_pool,i,BROKEN))
     {
         // If collided with projectile set up child objects.
-        if(BIT_IS_SET(asteroid_state[i],BROKEN))
+        if(pool_is(&asteroid_pool,i,BROKEN))
         {
 
             setup_child_object((i*2),bx,by,bdx,bdy,ax[i],ay[i]);
 
-            boulder_state[i*2] = (0<<BROKEN) |(1<<DRAWN) |(1<<MOVING);
-            boulder_state[(i*2)+1] = (0<<BROKEN) |(1<<DRAWN) |(1<<MOVING);
+            pool_set(&boulder_pool,i*2,(0<<BROKEN) |(1<<DRAWN) |(1<<MOVING));
+            pool_set(&boulder_pool,(i*2)+1,(0<<BROKEN) |(1<<DRAWN) |(1<<MOVING));
         }
         // If collided with shield reduce shield life
         if(ay[i]>39-7 )
         {
             shield_life--;
+            ship_hit_check(ax[i],ASTEROID);
         }
 
         ay[i]=-10;
         setup_asteroid(i);
 
-        asteroid_state[i] = (0<<DRAWN) | (0<<MOVING);
+        pool_set(&asteroid_pool,i,(0<<DRAWN) | (0<<MOVING));
     }
 
-    if(!BIT_IS_SET(asteroid_state[i],BROKEN))
+    if(!pool_is(&asteroid_pool,i,BROKEN))
     {
         draw_object(ax[i],ay[i],asteroid_direct,7,7);
     }
@@ -1570,6 +2373,12 @@ void draw_asteroid(int i)
 */
 void draw_update()
 {
+    // The ship zone is needed by the rocks that reach the barrier.
+    update_ship_sprite();
+    BENCH_SHIP_START();
+    collide_zone_build(ship_zone,ship_x,ship_sprite,SHIP_SPRITE_WIDTH);
+    BENCH_SHIP_END();
+
     draw_barrier();
     for(uint8_t i=0; i<MAX_ASTEROID; i++)
     {
@@ -1589,12 +2398,15 @@ void draw_update()
         draw_projectile(l);
     }
 
-    // Draw the ship
-    draw_object(ship_x,41,ship_direct,8,8);
-
-    // Draw the turret
-    draw_line(ship_x+7,44, (ship_x+7)+tx, ty, FG_COLOUR );
-    draw_line(ship_x+8,44, (ship_x+8)+tx, ty, FG_COLOUR );
+    // Draw the ship and turret, blinking while it cannot be hit
+    if(ship_invulnerable && (!GAME_IS(PAUSED)|| GAME_IS(CHEATED)))
+    {
+        ship_invulnerable--;
+    }
+    if(!(ship_invulnerable & SHIP_BLINK))
+    {
+        fb_blit_columns(ship_x,41,ship_sprite,SHIP_SPRITE_WIDTH);
+    }
 }
 // ----------------------------------------------------------
 
@@ -1615,15 +2427,9 @@ void get_pot_values()
         game_speed = tmp;
     }
 }
-void set_duty_cycle(int duty_cycle)
-{
-    TC4H = duty_cycle >> 8;
-
-    // (b)	Set bits 0..7 of Output Compare Register 4A.
-    OCR4A = duty_cycle & 0xff;
-}
 
 
+#ifdef SERIAL_DEBUG
 /**
 *   Function responsible for parsing the input from the serial console
 *
@@ -1639,49 +2445,41 @@ void set_duty_cycle(int duty_cycle)
 int receive_serial_cheat()
 {
     uint16_t in_char;
-    char * line1 = "Receiving";
-    char * line2 = "Input";
     uint8_t pos = 0;
 
     // Loop parser while input is set.
-    while(BIT_IS_SET(gamestate,INPUT))
+    while(GAME_IS(INPUT))
     {
         //gamestate |= (1<<CHEATED) | (1<<PAUSED);
-        draw_string((LCD_X/2)-((strlen(line1)*5)/2),(LCD_Y/2)-10,line1,FG_COLOUR);
-        draw_string((LCD_X/2)-((strlen(line2)*5)/2),(LCD_Y/2),line2,FG_COLOUR);
+        fb_draw_string(FB_CENTRE(FB_TEXT_WIDTH("Receiving")),(LCD_Y/2)-10,"Receiving",FG_COLOUR);
+        fb_draw_string(FB_CENTRE(FB_TEXT_WIDTH("Input")),(LCD_Y/2),"Input",FG_COLOUR);
         show_screen();
 
         if(usb_serial_available())
         {
             in_char = usb_serial_getchar();
 
-            // if character not enter add to buffer
+            // if character not enter add to buffer, the last byte is kept
+            // for the null and anything past it is dropped
             if(in_char!=13)
             {
-                in_buff[pos]=in_char;
-                if(pos>3)
-                    pos=0;
-                pos++;
+                if(pos<sizeof(in_buff)-1)
+                    in_buff[pos++]=in_char;
             }
 
 
             if(in_char==13)
             {
-                gamestate &= (0<<INPUT);
+                GAME_CLEAR(INPUT);
                 //gamestate |= (1<<CHEATED) | (1<<PAUSED);
             }
         }
     }
 
-    // Take the string
-    char arr[1][3];
-    int n, ret;
-    n=serial_to_int(in_buff,arr);
-    int t = atoi(arr[0]);
-    ret=t;
-
-    return t;
+    in_buff[pos]='\0';
+    return serial_to_int(in_buff);
 }
+#endif
 
 
 
@@ -1689,6 +2487,13 @@ void input()
 {
     int16_t char_code = usb_serial_getchar();
 
+#ifdef SERIAL_DEBUG
+    // Command frames are read in full each pass, key presses one at a time.
+    while(char_code >= 0 && remote_receive(char_code))
+    {
+        char_code = usb_serial_available() ? usb_serial_getchar() : -1;
+    }
+#endif
     if ( char_code >= 0 )
     {
         serial_input(char_code);
@@ -1696,28 +2501,28 @@ void input()
     peripheral_input();
 }
 
-int serial_to_int(char *base, char target[1][3])
-{
-    int n=0,i,j=0;
-
-    for(uint8_t i=0; 1; i++)
+#ifdef SERIAL_DEBUG
+/**
+*   Function for parsing the first space separated number in a string.
+*
+*   Parameters:
+*           base: The null terminated string received from the console.
+*
+*   Return: The number, only the first 6 characters ("-32768") are used.
+*/
+int serial_to_int(const char *base)
+{
+    char word[7];
+    uint8_t j=0;
+
+    while(*base && *base!=' ' && j<sizeof(word)-1)
     {
-        if(base[i]!=' ')
-        {
-            target[n][j++]=base[i];
-        }
-        else
-        {
-            target[n][j++]='\0';//insert NULL
-            n++;
-            j=0;
-        }
-        if(base[i]=='\0')
-            break;
+        word[j++]=*base++;
     }
-    return n;
-
+    word[j]='\0';
+    return atoi(word);
 }
+#endif
 
 void debug_draw()
 {
@@ -1725,53 +2530,71 @@ void debug_draw()
 }
 
 uint8_t print=0;
-void game_over_stuff()
+uint16_t game_over_start;
+
+/**
+*   Function for ending the game over message and moving on to the
+*   restart/quit choices.
+*/
+void game_over_finish()
 {
-    set_duty_cycle(lcd_led_value);
-    char *game_over_message = "GAME OVER";
-    char *restart_message = "SW1 - Restart";
-    char *quit_message = "SW2 - Quit";
+    led_pattern_stop();
+    GAME_SET(OVER);
+    GAME_SET(OVER_CHOICE);
+    backlight_fade(BACKLIGHT_FULL,BACKLIGHT_TICKS(2));
+    print=1;
+    game_over_state = GO_CHOICES;
+}
 
-    if(BIT_IS_SET(gamestate,OVER)&&!BIT_IS_SET(gamestate,OVER_CHOICE))
+/**
+*   Function responsible for the game over sequence, it is stepped once per
+*   frame and timed from the Timer0 tick count so the main loop (input and
+*   USB) keeps running the whole way through.
+*
+*   Note: The sequence is GO_DIM (backlight fades), GO_MESSAGE ("GAME OVER"
+*       shown for 2 seconds) then GO_CHOICES, a joystick center press skips
+*       to the choices.
+*/
+void game_over_stuff()
+{
+    if(GAME_IS(OVER)&&!GAME_IS(OVER_CHOICE))
     {
-        dim_lcd=1;
-        gamestate |= (1<<PAUSED);
+        if(game_over_state==GO_NONE)
+        {
+            game_over_state = GO_DIM;
+            backlight_fade(BACKLIGHT_OFF,BACKLIGHT_TICKS(2));
+            GAME_SET(PAUSED);
+        }
+
+        if(game_over_state==GO_DIM && backlight_done())
+        {
+            led_pattern_play(led_game_over,0);
+            game_over_start = get_ticks();
+            game_over_state = GO_MESSAGE;
+        }
 
-        if(lcd_led_value>=1022)
+        if(game_over_state==GO_MESSAGE)
         {
-            SET_BIT(PORTB,2);
-            SET_BIT(PORTB,3);
             clear_screen();
-            draw_string(LCD_X/2-((strlen(game_over_message)*5)/2),LCD_Y/2-5,game_over_message,FG_COLOUR);
-            show_screen();
-            _delay_ms(2000);
-            CLEAR_BIT(PORTB,2);
-            CLEAR_BIT(PORTB,3);
-            //shield_life=1;
-            gamestate |= (1<<OVER) | (1<<OVER_CHOICE);
-            dim_lcd =0;
-
-            print=1;
+            overlay_wanted = OVERLAY_OVER_MESSAGE;
+            if((uint16_t)(get_ticks() - game_over_start) >= SECONDS_TO_TICKS(2))
+            {
+                game_over_finish();
+            }
         }
     }
-    if(BIT_IS_SET(gamestate,OVER)&&BIT_IS_SET(gamestate,OVER_CHOICE))
+    if(GAME_IS(OVER)&&GAME_IS(OVER_CHOICE))
     {
         if(print)
         {
-            //gamestate = (1<<PAUSED)|(1<<OVER_CHOICE)|(0<<OVER);
             usb_serial_send("*********GAME OVER**********\r\n");
             status_to_serial();
             print=!print;
         }
 
-//            status_to_serial();
-        draw_string(LCD_X/2 - (8*5),LCD_Y/2-10,restart_message,FG_COLOUR);
-        draw_string(LCD_X/2 - (8*5),LCD_Y/2,quit_message,FG_COLOUR);
+        overlay_wanted |= OVERLAY_OVER_CHOICES;
 
     }
-    //gamestate |= (1<<PAUSED)|(1<<OVER_CHOICE)|(0<<OVER);
-    //show_screen();
-
 }
 
 // Was implemented but taken out due to not having been able to figure out direct
@@ -1801,31 +2624,26 @@ void game_over_stuff()
 uint8_t x,y;
 void intro()
 {
-    set_duty_cycle(lcd_led_value);
-
-    char * title1 = "SPACE PEW PEW";
-
     if(y>LCD_Y)
     {
-        x=rand()%LCD_X;
+        x=prng_range(PRNG_MISC,LCD_X);
         y=-10;
     }
     y++;
     draw_object(x,y,asteroid,7,7);
 
-    draw_string(LCD_X/2-(strlen(student_num)/2*5),10,student_num,FG_COLOUR);
-    draw_string(LCD_X/2-(strlen(title1)/2*5),20,title1,FG_COLOUR);
+    overlay_wanted |= OVERLAY_INTRO;
 }
 
 //void display_gamestates()
 //{
-//    draw_int(0,20,BIT_IS_SET(gamestate,CHEATED),FG_COLOUR);
-//    draw_int(10,20,BIT_IS_SET(gamestate,START),FG_COLOUR);
-//    draw_int(20,20,BIT_IS_SET(gamestate,OVER),FG_COLOUR);
-//    draw_int(30,20,BIT_IS_SET(gamestate,OVER_CHOICE),FG_COLOUR);
-//    draw_int(40,20,BIT_IS_SET(gamestate,INPUT),FG_COLOUR);
-//    draw_int(50,20,BIT_IS_SET(gamestate,PAUSED),FG_COLOUR);
-//    draw_int(60,20,BIT_IS_SET(gamestate,QUIT),FG_COLOUR);
+//    draw_int(0,20,GAME_IS(CHEATED),FG_COLOUR);
+//    draw_int(10,20,GAME_IS(START),FG_COLOUR);
+//    draw_int(20,20,GAME_IS(OVER),FG_COLOUR);
+//    draw_int(30,20,GAME_IS(OVER_CHOICE),FG_COLOUR);
+//    draw_int(40,20,GAME_IS(INPUT),FG_COLOUR);
+//    draw_int(50,20,GAME_IS(PAUSED),FG_COLOUR);
+//    draw_int(60,20,GAME_IS(QUIT),FG_COLOUR);
 //    draw_int(0,30,turret_override,FG_COLOUR);
 //    draw_int(10,30,speed_override,FG_COLOUR);
 //    draw_int(20,30,(int)return_manual,FG_COLOUR);
@@ -1833,8 +2651,10 @@ void intro()
 
 void process(void)
 {
+    profiler_frame_start();
 
     input();
+    profiler_mark(PROF_INPUT);
 
     clear_screen();
     if(intro_screen)
@@ -1844,23 +2664,35 @@ void process(void)
     else
     {
         get_pot_values();
+        profiler_mark(PROF_POTS);
         draw_update();
-        if(BIT_IS_SET(gamestate,PAUSED) && status_screen)
+        if(GAME_IS(PAUSED) && status_screen)
         {
             status_to_screen();
         }
+        profiler_mark(PROF_DRAW);
         //display_gamestates();
         game_over_stuff();
+        profiler_mark(PROF_GAME_OVER);
     }
+    overlay_update();
+    profiler_draw();
     show_screen();
+    profiler_mark(PROF_SHOW);
+    screen_stream_poll(get_ticks());
+    throughput_poll(get_ticks());
+#ifdef SERIAL_DEBUG
+    snapshot_store_poll();
+#endif
 
-    if(!BIT_IS_SET(gamestate,PAUSED))
+    if(!GAME_IS(PAUSED))
     {
         ship_movement();
     }
-    if(shield_life<1 &&!BIT_IS_SET(gamestate,OVER_CHOICE))
+    if(shield_life<1 &&!GAME_IS(OVER_CHOICE))
     {
-        gamestate |= (1<<OVER)|(1<<PAUSED);
+        GAME_SET(OVER);
+        GAME_SET(PAUSED);
     }
 
     //clear_last_bank();
@@ -1878,16 +2710,9 @@ int rand_seed()
 
 void quit_screen()
 {
-    uint8_t i,j;
-    clear_screen();
-    for(i=0; i<LCD_X; i++)
-        for(j=0; j<LCD_Y; j++)
-        {
-            draw_pixel(i, j, 1);
-        }
-
+    fb_fill_rect(0,0,LCD_X,LCD_Y,FB_SOLID);
 
-    draw_string(LCD_X/2-(strlen(student_num)*5 /2),(LCD_Y/2)-2,student_num,BG_COLOUR);
+    fb_draw_string(student_num_x,(LCD_Y/2)-2,student_num,BG_COLOUR);
     show_screen();
     input();
 }
@@ -1900,8 +2725,17 @@ void quit_screen()
 void setup(void)
 {
     teensy_init();
+    profiler_init();
+
+    // Start dark and fade the backlight up over the intro.
+    backlight_init(BACKLIGHT_OFF);
+    backlight_fade(BACKLIGHT_FULL,BACKLIGHT_TICKS(2));
     setup_usb_serial();
+    screen_stream_set_rate(STREAM_FPS);
     setup_images();
+
+    // Centered once here rather than on every frame.
+    student_num_x = FB_CENTRE(fb_string_width(student_num));
     setup_gamestate();
 }
 
@@ -1909,13 +2743,20 @@ void setup_gamestate(void)
 {
     gamestate = (0<<CHEATED)| (1<<START)| (0<<OVER)| (0<<OVER_CHOICE)|(0<<INPUT) | (1<<PAUSED) | (0<<QUIT);
     status_screen=0;
+    game_over_state=GO_NONE;
     score=0;
-    flash_led=0;
+    led_pattern_stop();
     shield_life=5;
     ship_x=42-4;
     game_time=0;
+    wave_number=0;
+    wave_speed=10;
 
-    if(rand()% 10 +1 > 5)
+    // Every game gets its own seed which is reported in the status so that
+    // a run can be replayed by setting replay_seed before restarting.
+    prng_seed(replay_seed ? replay_seed : prng_next(PRNG_MISC));
+
+    if(prng_range(PRNG_MISC,10) +1 > 5)
         direction = LEFT;
     else
         direction = RIGHT;
@@ -1929,14 +2770,776 @@ void setup_gamestate(void)
 
 // ----------------------------------------------------------
 
+#ifdef BENCHMARK
+// Benchmark scenes, each is a fixed seed game set up by its start function
+// and then played for BENCH_FRAMES frames with its frame function called
+// before every one, so every build runs exactly the same frames.
+#define BENCH_SEED 0x5EED
+#define BENCH_FRAMES 150
+#define BENCH_SPEED 5
+
+typedef struct
+{
+    const char * name;
+    void (*start)(void);
+    void (*frame)(uint16_t frame);
+    uint8_t needs_rocks;        // Fails the run if no rock ever falls.
+    void (*report)(void);
+} bench_scene_t;
+
+/**
+*   Function for starting a game that is already running at a fixed speed,
+*   as though the intro had been passed and the ship moved. The wave is
+*   loaded with its start delay and the first spawn delay already over, so
+*   rocks fall from the first frames rather than after most of the scene.
+*/
+static void bench_play(void)
+{
+    intro_screen = 0;
+    GAME_CLEAR(START);
+    GAME_CLEAR(PAUSED);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        wave_start();
+        wave_time = 3;
+        spawn_delay = rand_delay;
+    }
+}
+
+/**
+*   Function for sweeping the turret across its range, keeping the ship
+*   alive and firing as fast as the fire rate allows.
+*/
+static void bench_fire(uint16_t frame)
+{
+    tx = (frame/8) % 7 - 3;
+    shield_life = 5;
+    fire_plasma_bolt();
+}
+
+static void bench_intro_start(void)
+{
+    intro_screen = 1;
+}
+
+static void bench_idle(uint16_t frame)
+{
+}
+
+/**
+*   Function for filling the projectile pool, a bolt is fired every frame
+*   without waiting for the fire rate.
+*/
+static void bench_projectiles(uint16_t frame)
+{
+    tx = frame % 7 - 3;
+    shield_life = 5;
+    fired = 0;
+    fire_plasma_bolt();
+}
+
+/**
+*   Function for starting with every asteroid falling at once just above the
+*   ship, so bolts fired every frame split them into boulders and fragments.
+*/
+static void bench_split_start(void)
+{
+    bench_play();
+    for(uint8_t i=0; i<MAX_ASTEROID; i++)
+    {
+        ay[i] = 10;
+        pool_set(&asteroid_pool,i,(1<<DRAWN)|(1<<MOVING));
+    }
+}
+
+/**
+*   Function for breaking every asteroid in the first frame, the most
+*   splitting a single frame can do.
+*/
+static void bench_split_all_start(void)
+{
+    bench_play();
+    for(uint8_t i=0; i<MAX_ASTEROID; i++)
+    {
+        ay[i] = 20;
+        pool_set(&asteroid_pool,i,(1<<DRAWN)|(1<<MOVING)|(1<<BROKEN));
+    }
+}
+
+/**
+*   Function for breaking every boulder the asteroids split into at once,
+*   ten frames in.
+*/
+static void bench_split_all(uint16_t frame)
+{
+    shield_life = 5;
+    if(frame != 10)
+        return;
+    for(uint8_t i=0; i<MAX_BOULDER; i++)
+    {
+        if(pool_is(&boulder_pool,i,MOVING))
+            pool_set(&boulder_pool,i,(1<<DRAWN)|(1<<MOVING)|(1<<BROKEN));
+    }
+}
+
+static void bench_over_start(void)
+{
+    bench_play();
+    shield_life = 0;
+}
+
+// When the game over scene pressed the joystick and how long the choices
+// took to come up after it.
+static uint32_t bench_pressed;
+static uint32_t bench_latency;
+
+static void bench_over_input_start(void)
+{
+    bench_over_start();
+    bench_pressed = 0;
+    bench_latency = 0;
+}
+
+/**
+*   Function for pressing the joystick center as soon as the sequence has
+*   started, which skips to the restart/quit choices, and letting go once
+*   they are up.
+*/
+static void bench_over_input(uint16_t frame)
+{
+    if(game_over_state==GO_CHOICES)
+    {
+        if(bench_pressed && !bench_latency)
+            bench_latency = profiler_now() - bench_pressed;
+        bench_pinb = 0;
+    }
+    else if((game_over_state==GO_DIM || game_over_state==GO_MESSAGE) && !bench_pressed)
+    {
+        bench_pinb = (1<<0);
+        bench_pressed = profiler_now();
+    }
+}
+
+/**
+*   Function for reporting the cycles from the press to the end of the
+*   frame that showed the choices, debouncing included.
+*/
+static void bench_over_input_report(void)
+{
+    bench_metric("latency", bench_latency);
+}
+
+/**
+*   Function for flooding the serial console, each frame gets a status
+*   request and, with the remote protocol, three pings in front of it.
+*/
+static void bench_serial(uint16_t frame)
+{
+    static const uint8_t flood[] =
+    {
+#ifdef SERIAL_DEBUG
+        0x00, 0x02, 0x01, 0x03, 0x55, 0xC7, 0x00,
+        0x00, 0x02, 0x01, 0x03, 0x55, 0xC7, 0x00,
+        0x00, 0x02, 0x01, 0x03, 0x55, 0xC7, 0x00,
+#endif
+        's'
+    };
+    bench_fire(frame);
+    bench_feed(flood, sizeof(flood));
+}
+
+/**
+*   Function for starting at the last entry of the wave table, the biggest
+*   and fastest wave, with a bolt fired every frame so that the rocks it
+*   drops split and every pool fills.
+*/
+static void bench_stress_start(void)
+{
+    wave_number = 255;
+    bench_play();
+}
+
+// How many asteroids, boulders and fragments the rocks scenes hold.
+static uint8_t bench_held[3];
+
+/**
+*   Function for holding rocks still on screen by putting them back every
+*   frame with the game speed set to 0 so none fall or spawn. The first of
+*   each kind sits on the barrier over the ship, so every frame takes the
+*   ship hit test three times: the first hit takes the damage path, with
+*   the shield and invulnerability put back each frame, and the other two
+*   find the ship invulnerable. The rest are spread across the screen
+*   above the barrier. A bolt is never fired, so the frames differ only in
+*   how many rocks are drawn and swept.
+*/
+static void bench_rocks_hold(uint16_t frame)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        game_speed = 0;
+    }
+    shield_life = 5;
+    ship_invulnerable = 0;
+    for(uint8_t i=0; i<bench_held[0]; i++)
+    {
+        ax[i] = i ? i * (LCD_X-ASTEROID) / MAX_ASTEROID : ship_x + (SHIP_SPRITE_WIDTH-ASTEROID)/2;
+        ay[i] = i ? 4 : 39-7+1;
+        pool_set(&asteroid_pool,i,(1<<DRAWN)|(1<<MOVING));
+    }
+    for(uint8_t i=0; i<bench_held[1]; i++)
+    {
+        bx[i] = i ? i * (LCD_X-BOULDER) / MAX_BOULDER : ship_x + (SHIP_SPRITE_WIDTH-BOULDER)/2;
+        by[i] = i ? 16 : 39-5+1;
+        pool_set(&boulder_pool,i,(1<<DRAWN)|(1<<MOVING));
+    }
+    for(uint8_t i=0; i<bench_held[2]; i++)
+    {
+        fx[i] = i ? i * (LCD_X-FRAGMENT) / MAX_FRAG : ship_x + (SHIP_SPRITE_WIDTH-FRAGMENT)/2;
+        fy[i] = i ? 26 + (i & 1) * 5 : 39-3+1;
+        pool_set(&fragment_pool,i,(1<<DRAWN)|(1<<MOVING));
+    }
+}
+
+/**
+*   Function for starting a rocks scene with the given number of each rock.
+*/
+static void bench_rocks_start(uint8_t asteroids, uint8_t boulders, uint8_t fragments)
+{
+    bench_play();
+    bench_held[0] = asteroids;
+    bench_held[1] = boulders;
+    bench_held[2] = fragments;
+    bench_ship_cycles = 0;
+    bench_rocks_hold(0);
+}
+
+/**
+*   Function for starting with one asteroid above the barrier besides the
+*   three on it.
+*/
+static void bench_rocks_1_start(void)
+{
+    bench_rocks_start(2,1,1);
+}
+
+static void bench_rocks_full_start(void)
+{
+    bench_rocks_start(MAX_ASTEROID,MAX_BOULDER,MAX_FRAG);
+}
+
+/**
+*   Function for reporting the cycles a frame spent on the ship hit test,
+*   which must not grow with the number of rocks.
+*/
+static void bench_rocks_report(void)
+{
+    bench_metric("ship_cycles", bench_ship_cycles / BENCH_FRAMES);
+}
+
+#ifdef BENCH_SNAPSHOT
+// The blob named by "make BENCH_SNAPSHOT=<file>", linked into flash.
+extern const uint8_t _binary_bench_snapshot_bin_start[] PROGMEM;
+extern const uint8_t _binary_bench_snapshot_bin_end[] PROGMEM;
+
+/**
+*   Function for carrying on from a captured game. The blob is copied into
+*   the RAM snapshot as the remote protocol would write it and loaded, one
+*   that does not load in this build stops the run.
+*/
+static void bench_snapshot_start(void)
+{
+    uint8_t chunk[REMOTE_SNAPSHOT_CHUNK];
+    uint16_t size = _binary_bench_snapshot_bin_end - _binary_bench_snapshot_bin_start;
+    for(uint16_t offset=0; offset<size; offset+=sizeof(chunk))
+    {
+        uint8_t count = size - offset < sizeof(chunk) ? size - offset : sizeof(chunk);
+        memcpy_P(chunk, &_binary_bench_snapshot_bin_start[offset], count);
+        snapshot_write(offset, chunk, count);
+    }
+    if(!snapshot_game(SNAPSHOT_LOAD))
+        bench_fail("BENCH_SNAPSHOT does not load, it needs the same version and pool sizes");
+}
+#endif
+
+static const bench_scene_t bench_scenes[] =
+{
+    { "intro", bench_intro_start, bench_idle, 0 },
+    { "wave", bench_play, bench_fire, 1 },
+    { "projectiles", bench_play, bench_projectiles, 1 },
+    { "split", bench_split_start, bench_projectiles, 1 },
+    { "game_over", bench_over_start, bench_idle, 0 },
+    { "serial", bench_play, bench_serial, 1 },
+    { "wave_stress", bench_stress_start, bench_projectiles, 1 },
+    { "split_all", bench_split_all_start, bench_split_all, 1 },
+    { "game_over_input", bench_over_input_start, bench_over_input, 0, bench_over_input_report },
+    { "rocks_1", bench_rocks_1_start, bench_rocks_hold, 1, bench_rocks_report },
+    { "rocks_full", bench_rocks_full_start, bench_rocks_hold, 1, bench_rocks_report },
+#ifdef BENCH_SNAPSHOT
+    { "snapshot", bench_snapshot_start, bench_idle, 0 },
+#endif
+};
+
+/**
+*   Returns the number of rocks falling.
+*/
+static uint8_t bench_rocks(void)
+{
+    return pool_count(&asteroid_pool,MOVING) + pool_count(&boulder_pool,MOVING)
+           + pool_count(&fragment_pool,MOVING);
+}
+
+// Single operations timed on their own, each is called count times with
+// the game tick stopped and the cost of calling an empty op taken off.
+// Drawing a whole screen takes long enough in simavr to need fewer calls.
+// An op that needs the game in some state first has a setup, which is run
+// before the calls and not timed.
+#define BENCH_OPS 1000
+#define BENCH_DRAW_OPS 50
+
+typedef struct
+{
+    const char * name;
+    void (*op)(uint16_t i);
+    uint16_t count;
+    void (*setup)(void);
+} bench_op_t;
+
+static void bench_nothing(uint16_t i)
+{
+}
+
+static void bench_prng_next(uint16_t i)
+{
+    prng_next(PRNG_MISC);
+}
+
+static void bench_prng_range(uint16_t i)
+{
+    prng_range(PRNG_MISC, LCD_X);
+}
+
+/**
+*   Function for splitting one asteroid into its two boulders, the work
+*   each break adds to a frame.
+*/
+static void bench_split_children(uint16_t i)
+{
+    setup_child_object(0,bx,by,bdx,bdy,40,20);
+}
+
+static uint8_t bench_order[64];
+
+static void bench_shuffle_3(uint16_t i)
+{
+    prng_shuffle(PRNG_MISC, bench_order, 3);
+}
+
+static void bench_shuffle_16(uint16_t i)
+{
+    prng_shuffle(PRNG_MISC, bench_order, 16);
+}
+
+static void bench_shuffle_64(uint16_t i)
+{
+    prng_shuffle(PRNG_MISC, bench_order, 64);
+}
+
+static char bench_number[5];
+
+/**
+*   Function for drawing a number through the cab202 library, as draw_int did
+*   before the text renderer.
+*/
+static void bench_lib_int(uint8_t x, uint8_t y, int value)
+{
+    snprintf(bench_number, sizeof(bench_number), "%d", value);
+    draw_string(x, y, bench_number, FG_COLOUR);
+}
+
+/**
+*   Function for drawing the status text as status_to_screen did before the
+*   text renderer, each glyph plotted a pixel at a time by the cab202
+*   library's draw_string, on the rows it used then.
+*/
+static void bench_status_lib(uint16_t i)
+{
+    draw_string(0,0,"Time: ",FG_COLOUR);
+    bench_lib_int(30,0,(int)game_time);
+    draw_string(0,10,"Life: ",FG_COLOUR);
+    bench_lib_int(30,10,shield_life);
+    draw_string(0,20,"Score: ",FG_COLOUR);
+    bench_lib_int(30,20,score);
+}
+
+/**
+*   Function for drawing the same status text with fb_draw_string on the
+*   bank aligned rows the game uses now, where each glyph column is one
+*   byte written.
+*/
+static void bench_status_fb(uint16_t i)
+{
+    fb_draw_string(0,0,"Time: ",FG_COLOUR);
+    draw_int(30,0,(int)game_time,FG_COLOUR);
+    fb_draw_string(0,8,"Life: ",FG_COLOUR);
+    draw_int(30,8,shield_life,FG_COLOUR);
+    fb_draw_string(0,16,"Score: ",FG_COLOUR);
+    draw_int(30,16,score,FG_COLOUR);
+}
+
+/**
+*   Function for drawing the status text with fb_draw_string on the old
+*   rows, the shifted path that splits each column over two banks.
+*/
+static void bench_status_fb_shifted(uint16_t i)
+{
+    fb_draw_string(0,0,"Time: ",FG_COLOUR);
+    draw_int(30,0,(int)game_time,FG_COLOUR);
+    fb_draw_string(0,10,"Life: ",FG_COLOUR);
+    draw_int(30,10,shield_life,FG_COLOUR);
+    fb_draw_string(0,20,"Score: ",FG_COLOUR);
+    draw_int(30,20,score,FG_COLOUR);
+}
+
+/**
+*   Function for drawing the intro text as intro did before the overlay
+*   layer, through the library every frame.
+*/
+static void bench_intro_lib(uint16_t i)
+{
+    draw_string(LCD_X/2-(strlen(student_num)/2*5),10,student_num,FG_COLOUR);
+    draw_string(LCD_X/2-(strlen("SPACE PEW PEW")/2*5),20,"SPACE PEW PEW",FG_COLOUR);
+}
+
+static void bench_over_message_lib(uint16_t i)
+{
+    draw_string(LCD_X/2-((strlen("GAME OVER")*5)/2),LCD_Y/2-5,"GAME OVER",FG_COLOUR);
+}
+
+static void bench_over_choices_lib(uint16_t i)
+{
+    draw_string(LCD_X/2 - (8*5),LCD_Y/2-10,"SW1 - Restart",FG_COLOUR);
+    draw_string(LCD_X/2 - (8*5),LCD_Y/2,"SW2 - Quit",FG_COLOUR);
+}
+
+/**
+*   Function for compositing one screen's overlay the way process does each
+*   frame. Only the first call rasterises the text, the rest composite what
+*   the layer holds.
+*/
+static void bench_overlay(uint8_t screens)
+{
+    overlay_wanted = screens;
+    overlay_update();
+}
+
+static void bench_overlay_intro(uint16_t i)
+{
+    bench_overlay(OVERLAY_INTRO);
+}
+
+static void bench_overlay_status(uint16_t i)
+{
+    bench_overlay(OVERLAY_STATUS);
+}
+
+/**
+*   Function for compositing the status overlay with the score changing
+*   every frame, so one field is rasterised again each time.
+*/
+static void bench_overlay_status_score(uint16_t i)
+{
+    score = i;
+    bench_overlay(OVERLAY_STATUS);
+}
+
+static void bench_overlay_over_message(uint16_t i)
+{
+    bench_overlay(OVERLAY_OVER_MESSAGE);
+}
+
+static void bench_overlay_over_choices(uint16_t i)
+{
+    bench_overlay(OVERLAY_OVER_CHOICES);
+}
+
+/**
+*   Function for drawing the quit screen as quit_screen did before the fill
+*   primitives, a draw_pixel for every pixel of the screen. Neither quit
+*   op sends the buffer to the LCD.
+*/
+static void bench_quit_lib(uint16_t i)
+{
+    clear_screen();
+    for(uint8_t x=0; x<LCD_X; x++)
+    {
+        for(uint8_t y=0; y<LCD_Y; y++)
+        {
+            draw_pixel(x, y, 1);
+        }
+    }
+    draw_string(LCD_X/2-(strlen(student_num)*5 /2),(LCD_Y/2)-2,student_num,BG_COLOUR);
+}
+
+static void bench_quit_fb(uint16_t i)
+{
+    fb_fill_rect(0,0,LCD_X,LCD_Y,FB_SOLID);
+    fb_draw_string(student_num_x,(LCD_Y/2)-2,student_num,BG_COLOUR);
+}
+
+/**
+*   Function for drawing the barrier as draw_barrier did before the
+*   pattern rows, a pixel at a time.
+*/
+static void bench_barrier_lib(uint16_t i)
+{
+    for(uint8_t x=0; x<LCD_X; x++)
+    {
+        draw_pixel(x,39,x%2==0 ? FG_COLOUR : BG_COLOUR);
+    }
+}
+
+static void bench_barrier_fb(uint16_t i)
+{
+    draw_barrier();
+}
+
+/**
+*   Function for drawing the ship and turret as draw_update did before the
+*   combined sprite, the ship a pixel at a time and the turret as two
+*   library lines. The turret moves on every call.
+*/
+static void bench_ship_lib(uint16_t i)
+{
+    tx = i % 7 - 3;
+    draw_object(ship_x,41,ship_direct,8,8);
+    draw_line(ship_x+7,44, (ship_x+7)+tx, ty, FG_COLOUR );
+    draw_line(ship_x+8,44, (ship_x+8)+tx, ty, FG_COLOUR );
+}
+
+/**
+*   Function for drawing the ship and turret as one sprite blit with the
+*   turret moving on every call, so the sprite is rebuilt each time.
+*/
+static void bench_ship_fb(uint16_t i)
+{
+    tx = i % 7 - 3;
+    update_ship_sprite();
+    fb_blit_columns(ship_x,41,ship_sprite,SHIP_SPRITE_WIDTH);
+}
+
+/**
+*   Function for drawing the ship and turret as one sprite blit with the
+*   turret still, the usual frame where the sprite is already built.
+*/
+static void bench_ship_fb_still(uint16_t i)
+{
+    tx = 0;
+    update_ship_sprite();
+    fb_blit_columns(ship_x,41,ship_sprite,SHIP_SPRITE_WIDTH);
+}
+
+/**
+*   Function for testing a bolt a pixel left of the asteroid's box, thrown
+*   out by the box test like most pairs in a frame.
+*/
+static void bench_collide_reject(uint16_t i)
+{
+    collide_sprite(-3*FIX_ONE,(i&3)*FIX_ONE,0,-FIX_ONE,asteroid_mask,ASTEROID);
+}
+
+/**
+*   Function for testing a bolt that ends on the asteroid, found in the
+*   first cell.
+*/
+static void bench_collide_hit(uint16_t i)
+{
+    collide_sprite(3*FIX_ONE,(i&3)*FIX_ONE,0,-FIX_ONE,asteroid_mask,ASTEROID);
+}
+
+/**
+*   Function for testing a bolt that crosses the empty corner of the
+*   asteroid's box, the costliest miss, every cell on the path is walked.
+*/
+static void bench_collide_miss(uint16_t i)
+{
+    collide_sprite(7*FIX_ONE,4*FIX_ONE,3*FIX_ONE,-3*FIX_ONE,asteroid_mask,ASTEROID);
+}
+
+static void bench_fire_empty_setup(void)
+{
+    pool_clear(&projectile_pool);
+}
+
+/**
+*   Function for firing a bolt into an empty projectile pool, its slot is
+*   freed again so that every call finds the pool empty.
+*/
+static void bench_fire_empty(uint16_t i)
+{
+    fired = 0;
+    pool_set(&projectile_pool,fire_plasma_bolt(),0);
+}
+
+static void bench_fire_full_setup(void)
+{
+    pool_clear(&projectile_pool);
+    for(uint8_t i=0; i<MAX_PROJECTILE; i++)
+    {
+        fired = 0;
+        fire_plasma_bolt();
+    }
+}
+
+/**
+*   Function for firing with every projectile slot in flight. Under
+*   PROJECTILE_REJECT the shot is skipped, under PROJECTILE_RECYCLE the
+*   oldest bolt gives up its slot, and either way the pool stays full.
+*/
+static void bench_fire_full(uint16_t i)
+{
+    fired = 0;
+    fire_plasma_bolt();
+}
+
+static const bench_op_t bench_ops[] =
+{
+    { "prng_next", bench_prng_next, BENCH_OPS },
+    { "prng_range", bench_prng_range, BENCH_OPS },
+    { "shuffle_3", bench_shuffle_3, BENCH_OPS },
+    { "shuffle_16", bench_shuffle_16, BENCH_OPS },
+    { "shuffle_64", bench_shuffle_64, BENCH_OPS },
+    { "split_children", bench_split_children, BENCH_OPS },
+    { "status_lib", bench_status_lib, BENCH_DRAW_OPS },
+    { "status_fb", bench_status_fb, BENCH_DRAW_OPS },
+    { "status_fb_shifted", bench_status_fb_shifted, BENCH_DRAW_OPS },
+    { "intro_lib", bench_intro_lib, BENCH_DRAW_OPS },
+    { "overlay_intro", bench_overlay_intro, BENCH_DRAW_OPS },
+    { "overlay_status", bench_overlay_status, BENCH_DRAW_OPS },
+    { "overlay_status_score", bench_overlay_status_score, BENCH_DRAW_OPS },
+    { "over_message_lib", bench_over_message_lib, BENCH_DRAW_OPS },
+    { "overlay_over_message", bench_overlay_over_message, BENCH_DRAW_OPS },
+    { "over_choices_lib", bench_over_choices_lib, BENCH_DRAW_OPS },
+    { "overlay_over_choices", bench_overlay_over_choices, BENCH_DRAW_OPS },
+    { "quit_lib", bench_quit_lib, BENCH_DRAW_OPS },
+    { "quit_fb", bench_quit_fb, BENCH_DRAW_OPS },
+    { "barrier_lib", bench_barrier_lib, BENCH_OPS },
+    { "barrier_fb", bench_barrier_fb, BENCH_OPS },
+    { "ship_lib", bench_ship_lib, BENCH_OPS },
+    { "ship_fb", bench_ship_fb, BENCH_OPS },
+    { "ship_fb_still", bench_ship_fb_still, BENCH_OPS },
+    { "collide_reject", bench_collide_reject, BENCH_OPS },
+    { "collide_hit", bench_collide_hit, BENCH_OPS },
+    { "collide_miss", bench_collide_miss, BENCH_OPS },
+    { "fire_empty", bench_fire_empty, BENCH_OPS, bench_fire_empty_setup },
+    { "fire_full", bench_fire_full, BENCH_OPS, bench_fire_full_setup },
+};
+
+/**
+*   Returns the cycles taken by count calls of op.
+*/
+static uint32_t bench_time_op(void (*op)(uint16_t i), uint16_t count)
+{
+    uint32_t start = profiler_now();
+    for(uint16_t i=0; i<count; i++)
+    {
+        op(i);
+    }
+    return profiler_now() - start;
+}
+
+/**
+*   Function for timing every single operation benchmark, the game tick is
+*   stopped so it is not counted in them.
+*/
+static void bench_run_ops(void)
+{
+    TIMSK0 = 0;
+    for(uint8_t i=0; i<sizeof(bench_ops)/sizeof(bench_ops[0]); i++)
+    {
+        uint16_t count = bench_ops[i].count;
+        uint32_t overhead = bench_time_op(bench_nothing, count);
+        if(bench_ops[i].setup)
+            bench_ops[i].setup();
+        bench_report_ops(bench_ops[i].name, count, bench_time_op(bench_ops[i].op, count) - overhead);
+    }
+    TIMSK0 = 1;
+}
+
+/**
+*   Function for timing every benchmark scene in simavr, USB is never set
+*   up as there is nothing for it to connect to. Does not return.
+*/
+void benchmark(void)
+{
+    teensy_init();
+    profiler_init();
+
+    for(uint8_t i=0; i<sizeof(bench_scenes)/sizeof(bench_scenes[0]); i++)
+    {
+        replay_seed = BENCH_SEED;
+        setup_gamestate();
+        game_speed = BENCH_SPEED;
+        tx = 0;
+        bench_scenes[i].start();
+        profiler_isr_max = 0;
+        profiler_stack_paint();
+
+        // Only the frames are timed, not the counting between them.
+        uint32_t cycles = 0;
+        uint32_t frame_max = 0;
+        uint8_t rocks = 0;
+        for(uint16_t frame=0; frame<BENCH_FRAMES; frame++)
+        {
+            // timers() hands the pots back after a second, simavr's ADC
+            // would then stop the game, so the overrides are kept on.
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+            {
+                turret_override = 1;
+                speed_override = 1;
+                return_manual = 0;
+                game_speed = BENCH_SPEED;
+            }
+
+            uint32_t start = profiler_now();
+            bench_scenes[i].frame(frame);
+            process();
+            uint32_t elapsed = profiler_now() - start;
+            cycles += elapsed;
+            if(elapsed > frame_max)
+                frame_max = elapsed;
+
+            uint8_t falling = bench_rocks();
+            if(falling > rocks)
+                rocks = falling;
+        }
+        bench_report(bench_scenes[i].name, BENCH_FRAMES, cycles,
+                     profiler_isr_max, profiler_stack_used());
+        bench_metric("frame_max", frame_max);
+        bench_metric("rocks", rocks);
+        if(bench_scenes[i].report)
+            bench_scenes[i].report();
+        bench_end();
+
+        // Timing a wave that never spawned measures an empty screen.
+        if(bench_scenes[i].needs_rocks && !rocks)
+            bench_fail("no rocks fell in a scene that needs them");
+    }
+    bench_run_ops();
+    bench_stop();
+}
+#endif
+
 int main(void)
 {
-    srand(rand_seed());
+#ifdef BENCHMARK
+    benchmark();
+#endif
+    prng_seed(rand_seed());
     setup();
 
     for ( ;; )
     {
-        if(!BIT_IS_SET(gamestate,QUIT))
+        if(!GAME_IS(QUIT))
         {
             process();
         }
@@ -1950,10 +3553,10 @@ char buffer2[5];
 void draw_int(uint8_t x, uint8_t y, int value, colour_t colour)
 {
     snprintf(buffer2, sizeof(buffer2), "%d", value);
-    draw_string(x, y, buffer2, colour);
+    fb_draw_string(x, y, buffer2, colour);
 }
 void draw_double(uint8_t x, uint8_t y, double value, colour_t colour)
 {
     snprintf(buffer2, sizeof(buffer2), "%f", value);
-    draw_string(x, y, buffer2, colour);
+    fb_draw_string(x, y, buffer2, colour);
 }
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdint.h>
+#include <util/atomic.h>
+#include "pool_sizes.h"
+
+// Object pools keep one bit per slot for each state flag (DRAWN, MOVING and
+// BROKEN in main.c) instead of a byte per slot, so whole pool questions like
+// "is anything moving" are a single word test.
+#define POOL_FLAGS 3
+#define POOL_NONE 0xFF
+
+// Pools of up to 32 slots fit a uint32_t per flag, building with a bigger
+// pool (-DMAX_PROJECTILE=48) switches every pool to uint64_t.
+#if MAX_PROJECTILE > 32 || MAX_FRAG > 32
+typedef uint64_t pool_mask_t;
+#define POOL_SLOTS_MAX 64
+#else
+typedef uint32_t pool_mask_t;
+#define POOL_SLOTS_MAX 32
+#endif
+
+typedef struct
+{
+    pool_mask_t flags[POOL_FLAGS];
+} pool_t;
+
+// Mask of the slots in a pool of the given size.
+#define POOL_ALL(size) ((size) >= POOL_SLOTS_MAX ? ~(pool_mask_t)0 : (((pool_mask_t)1 << (size)) - 1))
+
+/**
+*   Returns non zero if flag is set for a slot.
+*/
+static inline uint8_t pool_is(const pool_t * pool, uint8_t slot, uint8_t flag)
+{
+    return (pool->flags[flag] >> slot) & 1;
+}
+
+/**
+*   Function for replacing every flag of a slot at once. The game tick
+*   interrupt spawns asteroids with this while the main loop updates the
+*   same masks, so the read, modify and write of the multi byte words is
+*   done with interrupts off or a spawn could be lost.
+*
+*   Parameters:
+*           state: The flags in the old per slot byte form, (1<<DRAWN)|...
+*/
+static inline void pool_set(pool_t * pool, uint8_t slot, uint8_t state)
+{
+    pool_mask_t bit = (pool_mask_t)1 << slot;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for(uint8_t flag=0; flag<POOL_FLAGS; flag++)
+        {
+            if(state & (1 << flag))
+                pool->flags[flag] |= bit;
+            else
+                pool->flags[flag] &= ~bit;
+        }
+    }
+}
+
+/**
+*   Returns every flag of a slot in the old per slot byte form.
+*/
+static inline uint8_t pool_get(const pool_t * pool, uint8_t slot)
+{
+    uint8_t state = 0;
+    for(uint8_t flag=0; flag<POOL_FLAGS; flag++)
+    {
+        state |= pool_is(pool, slot, flag) << flag;
+    }
+    return state;
+}
+
+/**
+*   Function for clearing every flag of every slot.
+*/
+static inline void pool_clear(pool_t * pool)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for(uint8_t flag=0; flag<POOL_FLAGS; flag++)
+        {
+            pool->flags[flag] = 0;
+        }
+    }
+}
+
+/**
+*   Returns non zero if any slot has flag set.
+*/
+static inline uint8_t pool_any(const pool_t * pool, uint8_t flag)
+{
+    return pool->flags[flag] != 0;
+}
+
+/**
+*   Returns the number of slots with flag set.
+*/
+static inline uint8_t pool_count(const pool_t * pool, uint8_t flag)
+{
+#if POOL_SLOTS_MAX > 32
+    return __builtin_popcountll(pool->flags[flag]);
+#else
+    return __builtin_popcountl(pool->flags[flag]);
+#endif
+}
+
+/**
+*   Returns the first slot of a pool of the given size without flag set,
+*   POOL_NONE if every slot has it.
+*/
+static inline uint8_t pool_first_clear(const pool_t * pool, uint8_t size, uint8_t flag)
+{
+    pool_mask_t free = ~pool->flags[flag] & POOL_ALL(size);
+    if(!free)
+        return POOL_NONE;
+#if POOL_SLOTS_MAX > 32
+    return __builtin_ctzll(free);
+#else
+    return __builtin_ctzl(free);
+#endif
+}
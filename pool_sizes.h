@@ -0,0 +1,15 @@
+#pragma once
+
+// Pool capacities, these can be overridden at compile time with -D.
+// Boulder and fragment pools are derived from the asteroid pool as each
+// parent owns two fixed child slots (see setup_child_object). Kept apart
+// from main.c so that pool.h sizes its masks the same whatever it is
+// included after.
+#ifndef MAX_ASTEROID
+#define MAX_ASTEROID 3
+#endif
+#define MAX_BOULDER (MAX_ASTEROID*2)
+#define MAX_FRAG (MAX_BOULDER*2)
+#ifndef MAX_PROJECTILE
+#define MAX_PROJECTILE 30
+#endif
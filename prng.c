@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include "prng.h"
+
+static uint16_t prng_state[PRNG_STREAMS];
+static uint16_t prng_seed_value;
+
+/**
+*   Function for seeding every stream from a single value, the value is kept
+*   so a run can be reproduced by seeding with it again.
+*
+*   Parameters:
+*           seed: The seed all streams are derived from.
+*/
+void prng_seed(uint16_t seed)
+{
+    prng_seed_value = seed;
+    for(uint8_t i=0; i<PRNG_STREAMS; i++)
+    {
+        // Give each stream its own starting point, xorshift can never
+        // leave the all zero state so that is avoided.
+        uint16_t state = seed ^ (0x9E37 * (i+1));
+        if(state==0)
+            state = 0xACE1;
+        prng_state[i] = state;
+        prng_next(i);
+        prng_next(i);
+    }
+}
+
+/**
+*   Returns the seed last passed to prng_seed.
+*/
+uint16_t prng_get_seed()
+{
+    return prng_seed_value;
+}
+
+/**
+*   Function for copying out every stream and the seed, for snapshots.
+*
+*   Parameters:
+*           state: Room for PRNG_STREAMS values followed by the seed.
+*/
+void prng_get_state(uint16_t * state)
+{
+    for(uint8_t i=0; i<PRNG_STREAMS; i++)
+    {
+        state[i] = prng_state[i];
+    }
+    state[PRNG_STREAMS] = prng_seed_value;
+}
+
+/**
+*   Function for putting back state copied out by prng_get_state.
+*/
+void prng_set_state(const uint16_t * state)
+{
+    for(uint8_t i=0; i<PRNG_STREAMS; i++)
+    {
+        // A zero state would stick at zero forever
+        prng_state[i] = state[i] ? state[i] : 0xACE1;
+    }
+    prng_seed_value = state[PRNG_STREAMS];
+}
+
+/**
+*   16 bit xorshift generator (shift triple 7, 9, 8) with a period of 65535.
+*
+*   Parameters:
+*           stream: The stream to advance.
+*
+*   Return: The next 16 bit value from the stream.
+*/
+uint16_t prng_next(uint8_t stream)
+{
+    uint16_t x = prng_state[stream];
+    x ^= x << 7;
+    x ^= x >> 9;
+    x ^= x << 8;
+    prng_state[stream] = x;
+    return x;
+}
+
+/**
+*   Function for getting a random value in a range without modulo bias. The
+*   16 bit value is scaled by n and the top bits kept, then the few values
+*   that would make some results one more likely than others (told by the
+*   low 16 bits of the product) are drawn again, Lemire's method. The only
+*   division is on that path, taken at most n times in 65536.
+*
+*   xorshift never gives 0, which the check rejects anyway unless n is a
+*   power of two, then 0 is one value in 65536 short.
+*
+*   Parameters:
+*           stream: The stream to take the value from.
+*           n: The size of the range.
+*
+*   Return: A value from 0 to n-1.
+*/
+uint8_t prng_range(uint8_t stream, uint8_t n)
+{
+    uint32_t scaled = (uint32_t)prng_next(stream) * n;
+    if((uint16_t)scaled < n)
+    {
+        // 65536 % n, the number of values that have to be thrown away.
+        uint16_t reject = (uint16_t)(0 - n) % n;
+        while((uint16_t)scaled < reject)
+        {
+            scaled = (uint32_t)prng_next(stream) * n;
+        }
+    }
+    return scaled >> 16;
+}
+
+/**
+*   Function for shuffling an array of uint8_t values in place with a
+*   Fisher-Yates shuffle. Orderings are only as even as the picks, which
+*   prng_range makes exact except for picks out of a power of two, where
+*   the first element is one value in 65536 short.
+*
+*   Parameters:
+*           stream: The stream to take the picks from.
+*           array: a pointer that leads to the array to be shuffled
+*           length: the number of elements in the array
+*/
+void prng_shuffle(uint8_t stream, uint8_t * array, uint8_t length)
+{
+    uint8_t i,j,tmp;
+
+    for(i=length; i>1; i--)
+    {
+        // Pick from the elements not yet placed, including the current one.
+        j= prng_range(stream,i);
+        tmp=array[i-1];
+        array[i-1]=array[j];
+        array[j]=tmp;
+    }
+}
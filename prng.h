@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+// Independent random streams, one per subsystem so that using random
+// numbers in one place does not change the sequence seen by another.
+#define PRNG_WAVE 0
+#define PRNG_SPAWN 1
+#define PRNG_SPLIT 2
+#define PRNG_MISC 3
+#define PRNG_STREAMS 4
+
+void prng_seed(uint16_t seed);
+uint16_t prng_get_seed(void);
+uint16_t prng_next(uint8_t stream);
+uint8_t prng_range(uint8_t stream, uint8_t n);
+void prng_shuffle(uint8_t stream, uint8_t * array, uint8_t length);
+void prng_get_state(uint16_t * state);
+void prng_set_state(const uint16_t * state);
@@ -0,0 +1,234 @@
+#ifdef PROFILER
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <graphics.h>
+#include "lcd.h"
+#include "serial_writer.h"
+#include "profiler.h"
+
+// Samples are kept in units of 16 cycles (2us at 8MHz) so a phase of up to
+// about 131ms fits in a uint16_t.
+#define PROFILER_SHIFT 4
+#define PROFILER_FRAMES 8
+
+// Frame budget the overlay bars are scaled against, 30 frames per second.
+#define PROFILER_BUDGET ((F_CPU/30) >> PROFILER_SHIFT)
+
+// Free RAM between the variables and the stack is painted with this so the
+// deepest the stack has reached can be found later. Nothing calls malloc so
+// the heap never grows into it.
+#define PROFILER_PAINT 0xC5
+
+// Bytes just below the stack pointer that are left unpainted, they belong
+// to the painting itself.
+#define PROFILER_PAINT_MARGIN 16
+
+extern uint8_t __heap_start;
+
+uint8_t profiler_overlay=0;
+
+// Longest time spent in the game tick interrupt in CPU cycles, not counting
+// the register saves either side of it.
+uint16_t profiler_isr_max=0;
+static uint16_t profiler_isr_start;
+
+static volatile uint16_t profiler_overflows=0;
+static uint32_t profiler_last;
+static uint16_t profiler_samples[PROFILER_FRAMES][PROF_PHASES];
+static uint8_t profiler_frame=0;
+
+ISR(TIMER1_OVF_vect)
+{
+    profiler_overflows++;
+}
+
+/**
+*   Function for setting Timer1 free running with no pre-scale so every
+*   count is a single CPU cycle, overflows extend it to 32 bits. The stack
+*   is painted here for the watermark.
+*/
+void profiler_init()
+{
+    TCCR1A = 0;
+    TCCR1B = (1<<CS10);
+    TIMSK1 |= (1<<TOIE1);
+    profiler_stack_paint();
+}
+
+/**
+*   Function for marking the start of an interrupt handler, only to be
+*   called with interrupts off.
+*/
+void profiler_isr_enter()
+{
+    profiler_isr_start = TCNT1;
+}
+
+/**
+*   Function for marking the end of an interrupt handler and keeping the
+*   longest. Handlers are far shorter than a Timer1 overflow so the 16 bit
+*   difference is enough.
+*/
+void profiler_isr_exit()
+{
+    uint16_t elapsed = TCNT1 - profiler_isr_start;
+    if(elapsed > profiler_isr_max)
+        profiler_isr_max = elapsed;
+}
+
+/**
+*   Function for painting the unused stack so profiler_stack_used can find
+*   the deepest point reached from here on.
+*/
+void profiler_stack_paint()
+{
+    uint8_t * end = (uint8_t *)SP - PROFILER_PAINT_MARGIN;
+    for(uint8_t * p = &__heap_start; p < end; p++)
+    {
+        *p = PROFILER_PAINT;
+    }
+}
+
+/**
+*   Returns the most stack used in bytes since it was painted.
+*/
+uint16_t profiler_stack_used()
+{
+    const uint8_t * p = &__heap_start;
+    while(p <= (const uint8_t *)RAMEND && *p == PROFILER_PAINT)
+    {
+        p++;
+    }
+    return RAMEND + 1 - (uint16_t)p;
+}
+
+/**
+*   Returns the number of cycles since the profiler was started.
+*/
+uint32_t profiler_now()
+{
+    uint8_t intr_state = SREG;
+    cli();
+    uint16_t low = TCNT1;
+    uint16_t high = profiler_overflows;
+
+    // An overflow that has not been serviced yet belongs to this reading
+    // if the counter has already wrapped.
+    if((TIFR1 & (1<<TOV1)) && low < 0x8000)
+        high++;
+    SREG = intr_state;
+    return ((uint32_t)high << 16) | low;
+}
+
+/**
+*   Function for starting a new frame in the ring of samples.
+*/
+void profiler_frame_start()
+{
+    profiler_frame = (profiler_frame+1) % PROFILER_FRAMES;
+    for(uint8_t i=0; i<PROF_PHASES; i++)
+    {
+        profiler_samples[profiler_frame][i]=0;
+    }
+    profiler_last = profiler_now();
+}
+
+/**
+*   Function for recording the time taken since the previous mark.
+*
+*   Parameters:
+*           phase: The phase that has just finished.
+*/
+void profiler_mark(uint8_t phase)
+{
+    uint32_t now = profiler_now();
+    uint32_t elapsed = (now - profiler_last) >> PROFILER_SHIFT;
+
+    profiler_samples[profiler_frame][phase] = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+    profiler_last = now;
+}
+
+/**
+*   Function for working out the min, average and max of a phase over the
+*   frames in the ring.
+*/
+static void profiler_stats(uint8_t phase, uint16_t * min, uint16_t * avg, uint16_t * max)
+{
+    uint32_t total=0;
+    *min = 0xFFFF;
+    *max = 0;
+    for(uint8_t i=0; i<PROFILER_FRAMES; i++)
+    {
+        uint16_t sample = profiler_samples[i][phase];
+        total += sample;
+        if(sample < *min)
+            *min = sample;
+        if(sample > *max)
+            *max = sample;
+    }
+    *avg = total / PROFILER_FRAMES;
+}
+
+/**
+*   Function for drawing a bar per phase across the top of the screen, a
+*   full width bar is the whole frame budget. The average is drawn solid
+*   with a single pixel marking the max.
+*/
+void profiler_draw()
+{
+    if(!profiler_overlay)
+        return;
+
+    for(uint8_t phase=0; phase<PROF_PHASES; phase++)
+    {
+        uint16_t min, avg, max;
+        profiler_stats(phase, &min, &avg, &max);
+
+        uint32_t avg_x = (uint32_t)avg * (LCD_X-1) / PROFILER_BUDGET;
+        uint32_t max_x = (uint32_t)max * (LCD_X-1) / PROFILER_BUDGET;
+        if(avg_x > LCD_X-1)
+            avg_x = LCD_X-1;
+        if(max_x > LCD_X-1)
+            max_x = LCD_X-1;
+
+        uint8_t y = phase*2;
+        draw_line(0, y, avg_x, y, FG_COLOUR);
+        draw_pixel(max_x, y, FG_COLOUR);
+    }
+}
+
+/**
+*   Function for sending the min, average and max of every phase to the
+*   serial console in CPU cycles.
+*/
+void profiler_to_serial()
+{
+    static char * const names[PROF_PHASES] =
+    {
+        "input ", "pots ", "draw ", "over ", "show "
+    };
+
+    serial_writer_append("phase min avg max (cycles/16)\r\n");
+    for(uint8_t phase=0; phase<PROF_PHASES; phase++)
+    {
+        uint16_t min, avg, max;
+        profiler_stats(phase, &min, &avg, &max);
+        serial_writer_append(names[phase]);
+        serial_writer_append_uint(min);
+        serial_writer_append(" ");
+        serial_writer_append_uint(avg);
+        serial_writer_append(" ");
+        serial_writer_append_uint(max);
+        serial_writer_append("\r\n");
+    }
+    serial_writer_append("isr max ");
+    serial_writer_append_uint(profiler_isr_max);
+    serial_writer_append(" cycles, stack ");
+    serial_writer_append_uint(profiler_stack_used());
+    serial_writer_append(" bytes\r\n");
+    serial_writer_commit();
+}
+
+#endif
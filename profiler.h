@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+// Phases of process() that are timed, each mark closes the phase that
+// started at the previous mark.
+#define PROF_INPUT 0
+#define PROF_POTS 1
+#define PROF_DRAW 2
+#define PROF_GAME_OVER 3
+#define PROF_SHOW 4
+#define PROF_PHASES 5
+
+// The profiler only exists when built with "make PROFILER=1", otherwise
+// every hook compiles to nothing.
+#ifdef PROFILER
+extern uint8_t profiler_overlay;
+extern uint16_t profiler_isr_max;
+
+void profiler_init(void);
+uint32_t profiler_now(void);
+void profiler_isr_enter(void);
+void profiler_isr_exit(void);
+void profiler_stack_paint(void);
+uint16_t profiler_stack_used(void);
+void profiler_frame_start(void);
+void profiler_mark(uint8_t phase);
+void profiler_draw(void);
+void profiler_to_serial(void);
+#else
+#define profiler_init()
+#define profiler_isr_enter()
+#define profiler_isr_exit()
+#define profiler_frame_start()
+#define profiler_mark(phase)
+#define profiler_draw()
+#define profiler_to_serial()
+#endif
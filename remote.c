@@ -0,0 +1,216 @@
+#include <stdint.h>
+#include <string.h>
+#include "usb_serial.h"
+#include "serial_writer.h"
+#include "remote.h"
+#include "throughput.h"
+
+// A COBS frame is at most one byte longer than the data for frames this size.
+#define REMOTE_ENCODED_MAX (REMOTE_FRAME_MAX+2)
+#define REMOTE_REPLY_HEADER_SIZE 3
+
+static uint8_t frame[REMOTE_FRAME_MAX];
+static uint8_t frame_length;
+static uint8_t frame_received;
+static uint8_t frame_error;
+static uint8_t in_frame=0;
+
+// COBS decoder state, the number of bytes left before the next code byte
+// and whether the last code byte stands for a zero.
+static uint8_t code_left;
+static uint8_t zero_pending;
+
+/**
+*   Returns the CRC-8 (polynomial 0x07, initial value 0) of a block of bytes.
+*/
+uint8_t remote_crc8(const uint8_t * bytes, uint8_t length)
+{
+    uint8_t crc = 0;
+    while(length--)
+    {
+        crc ^= *bytes++;
+        for(uint8_t i=0; i<8; i++)
+        {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/**
+*   Function for COBS encoding a block of bytes.
+*
+*   Returns: The number of encoded bytes written to out.
+*/
+static uint8_t cobs_encode(const uint8_t * in, uint8_t length, uint8_t * out)
+{
+    uint8_t code_at = 0;
+    uint8_t code = 1;
+    uint8_t n = 1;
+
+    for(uint8_t i=0; i<length; i++)
+    {
+        if(in[i] == 0)
+        {
+            out[code_at] = code;
+            code_at = n++;
+            code = 1;
+        }
+        else
+        {
+            out[n++] = in[i];
+            if(++code == 0xFF)
+            {
+                out[code_at] = code;
+                code_at = n++;
+                code = 1;
+            }
+        }
+    }
+    out[code_at] = code;
+    return n;
+}
+
+/**
+*   Function for framing and sending a reply.
+*
+*   Parameters:
+*           reply: The reply with the payload already in place after the
+*                  REMOTE_REPLY_HEADER_SIZE header bytes.
+*           length: The length of the payload.
+*
+*   Note: While a throughput test runs only the replies to the test's own
+*         commands are sent, each in a single write so that it lands
+*         between two chunks.
+*/
+static void send_reply(uint8_t opcode, uint8_t sequence, uint8_t status,
+                       uint8_t * reply, uint8_t length)
+{
+    uint8_t encoded[REMOTE_ENCODED_MAX+2];
+    uint8_t encoded_length;
+
+    reply[0] = opcode | REMOTE_REPLY;
+    reply[1] = sequence;
+    reply[2] = status;
+    length += REMOTE_REPLY_HEADER_SIZE;
+    reply[length] = remote_crc8(reply, length);
+
+    encoded[0] = 0;
+    encoded_length = 1 + cobs_encode(reply, length+1, &encoded[1]);
+    encoded[encoded_length++] = 0;
+
+    if(throughput_active())
+    {
+        if(opcode == REMOTE_THROUGHPUT || opcode == REMOTE_THROUGHPUT_RESULT)
+            usb_serial_write(encoded, encoded_length);
+        return;
+    }
+    serial_writer_append_bytes(encoded, encoded_length);
+    serial_writer_commit();
+}
+
+/**
+*   Function for checking a decoded frame and running the command in it.
+*/
+static void handle_frame()
+{
+    uint8_t reply[REMOTE_FRAME_MAX];
+    uint8_t * reply_payload = &reply[REMOTE_REPLY_HEADER_SIZE];
+    uint8_t reply_length = 0;
+    uint8_t opcode = frame_length > 0 ? frame[0] : 0;
+    uint8_t sequence = frame_length > 1 ? frame[1] : 0;
+    uint8_t status;
+
+    if(frame_error || code_left || frame_length < REMOTE_HEADER_SIZE+1)
+    {
+        status = REMOTE_BAD_FRAME;
+    }
+    else if(remote_crc8(frame, frame_length-1) != frame[frame_length-1])
+    {
+        status = REMOTE_BAD_CRC;
+    }
+    else
+    {
+        const uint8_t * payload = &frame[REMOTE_HEADER_SIZE];
+        uint8_t length = frame_length - REMOTE_HEADER_SIZE - 1;
+
+        if(opcode == REMOTE_PING)
+        {
+            reply_length = length;
+            if(reply_length > REMOTE_FRAME_MAX-REMOTE_REPLY_HEADER_SIZE-1)
+                reply_length = REMOTE_FRAME_MAX-REMOTE_REPLY_HEADER_SIZE-1;
+            memcpy(reply_payload, payload, reply_length);
+            status = REMOTE_OK;
+        }
+        else
+        {
+            status = remote_command(opcode, payload, length, reply_payload, &reply_length);
+        }
+    }
+    send_reply(opcode, sequence, status, reply, reply_length);
+}
+
+/**
+*   Function for feeding a received serial byte to the command decoder, call
+*   for every byte before treating it as a key press.
+*
+*   Parameters:
+*           byte: The received byte.
+*
+*   Returns: 1 if the byte was part of a command frame, 0 if it is an
+*            ordinary key press.
+*
+*   Note: Frames are decoded as the bytes arrive and the command is run when
+*         the closing delimiter is received, so nothing ever waits on the
+*         rest of a frame.
+*/
+uint8_t remote_receive(uint8_t byte)
+{
+    if(!in_frame)
+    {
+        if(byte != 0)
+            return 0;
+        in_frame = 1;
+        frame_length = 0;
+        frame_received = 0;
+        frame_error = 0;
+        code_left = 0;
+        zero_pending = 0;
+        return 1;
+    }
+
+    if(byte == 0)
+    {
+        // Extra delimiters before any data keep the frame open so a host can
+        // always resync by sending a few zeros.
+        if(frame_received)
+        {
+            handle_frame();
+            in_frame = 0;
+        }
+        return 1;
+    }
+
+    frame_received = 1;
+    if(code_left == 0)
+    {
+        if(zero_pending)
+        {
+            if(frame_length < REMOTE_FRAME_MAX)
+                frame[frame_length++] = 0;
+            else
+                frame_error = 1;
+        }
+        code_left = byte - 1;
+        zero_pending = byte != 0xFF;
+    }
+    else
+    {
+        if(frame_length < REMOTE_FRAME_MAX)
+            frame[frame_length++] = byte;
+        else
+            frame_error = 1;
+        code_left--;
+    }
+    return 1;
+}
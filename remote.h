@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+// Binary commands share the serial port with the single key controls. A 0x00
+// byte (never sent by a terminal) starts a frame and the next 0x00 ends it,
+// in between the frame is COBS encoded so it never contains a 0x00 itself:
+//
+//      0x00, COBS(opcode, sequence, payload..., crc), 0x00
+//
+// The crc is CRC-8 (polynomial 0x07) of every byte before it. Each command
+// gets one reply framed the same way, with the opcode | REMOTE_REPLY, the
+// same sequence number, a REMOTE_ status byte and then the reply payload.
+// 16 bit values are little endian.
+#define REMOTE_FRAME_MAX 40
+#define REMOTE_HEADER_SIZE 2
+#define REMOTE_REPLY 0x80
+
+// Opcodes
+#define REMOTE_PING 0x01      // Reply echoes the payload
+#define REMOTE_SET 0x02       // Payload: (param, int16 value) repeated
+#define REMOTE_GET 0x03       // Payload: param ids, reply: int16 per param
+#define REMOTE_PLACE 0x04     // Payload: object, index, x, y
+#define REMOTE_RESTART 0x05   // Start a new game, using PARAM_SEED if set
+#define REMOTE_SNAPSHOT_SAVE 0x06   // Save the game to the RAM snapshot, reply: uint16 size
+#define REMOTE_SNAPSHOT_READ 0x07   // Payload: uint16 offset, count, reply: bytes
+#define REMOTE_SNAPSHOT_WRITE 0x08  // Payload: uint16 offset, bytes
+#define REMOTE_SNAPSHOT_LOAD 0x09   // Load the game from the RAM snapshot, reply: uint16 size
+#define REMOTE_THROUGHPUT 0x0A      // Payload: seconds, chunks per frame (throughput.h)
+#define REMOTE_THROUGHPUT_RESULT 0x0B  // Reply: the counts of the last test
+#define REMOTE_SNAPSHOT_STORE 0x0C  // Payload: 1 starts copying the RAM snapshot to
+                                    // EEPROM, empty asks, reply: uint16 bytes left
+#define REMOTE_SNAPSHOT_FETCH 0x0D  // Copy the EEPROM snapshot to RAM, reply: uint16 size
+
+// Largest block moved by one REMOTE_SNAPSHOT_READ or REMOTE_SNAPSHOT_WRITE.
+#define REMOTE_SNAPSHOT_CHUNK 32
+
+// Reply status
+#define REMOTE_OK 0
+#define REMOTE_BAD_CRC 1
+#define REMOTE_BAD_FRAME 2
+#define REMOTE_BAD_OPCODE 3
+#define REMOTE_BAD_PAYLOAD 4
+#define REMOTE_BUSY 5          // The throughput test, screen stream or EEPROM copy
+                               // is still running
+
+// Parameters for REMOTE_SET and REMOTE_GET
+#define PARAM_SCORE 0
+#define PARAM_LIVES 1
+#define PARAM_SPEED 2         // Game speed x10, 0-100 like 'm'
+#define PARAM_TURRET 3        // Turret heading, -60 to 60 like 'o'
+#define PARAM_SHIP_X 4
+#define PARAM_PAUSED 5
+#define PARAM_SEED 6          // Seed for the next game, 0 for random
+#define PARAM_WAVE 7          // Next wave to be loaded
+#define PARAM_STREAM_FPS 8    // Screen stream rate, 0 stops it
+#define PARAM_COUNT 9
+
+uint8_t remote_crc8(const uint8_t * bytes, uint8_t length);
+uint8_t remote_receive(uint8_t byte);
+
+// Implemented by the game, runs a decoded command other than REMOTE_PING.
+// The reply payload (at most REMOTE_FRAME_MAX-4 bytes) is written to reply.
+// Returns: A REMOTE_ status.
+uint8_t remote_command(uint8_t opcode, const uint8_t * payload, uint8_t length,
+                       uint8_t * reply, uint8_t * reply_length);
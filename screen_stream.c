@@ -0,0 +1,268 @@
+#ifdef SCREEN_STREAM
+
+#include <stdint.h>
+#include <string.h>
+#include <graphics.h>
+#include "lcd.h"
+#include "usb_serial.h"
+#include "screen_stream.h"
+#include "throughput.h"
+
+#define STREAM_BANKS (LCD_Y/8)
+#define STREAM_IDLE 0xFF
+#define STREAM_DONE (STREAM_BANKS+1)
+#define STREAM_NEXT_BANK 0xFF
+
+// Ticks of the Timer0 overflow (about 488 a second) between frames.
+#define STREAM_TICKS_PER_SECOND ((uint16_t)(8000000.0 / (64.0 * 256.0)))
+
+// Every this many frames the whole screen is sent so a viewer started part
+// way through catches up.
+#define STREAM_KEY_INTERVAL 32
+
+// Literals are kept short so a token never takes up most of a chunk, runs
+// shorter than this are cheaper sent as part of a literal.
+#define STREAM_LITERAL_MAX 32
+#define STREAM_RUN_MAX 128
+#define STREAM_RUN_MIN 3
+
+uint8_t screen_stream_fps=0;
+uint16_t screen_stream_frames=0;
+uint16_t screen_stream_frame_bytes=0;
+
+// What the viewer should be showing, each bank is updated as it is encoded.
+static uint8_t stream_shadow[LCD_X*STREAM_BANKS];
+static uint8_t stream_delta[LCD_X];
+static uint8_t stream_chunk[STREAM_CHUNK_SIZE];
+static uint8_t stream_chunk_length=0;
+
+static uint16_t stream_interval;
+static uint16_t stream_last;
+static uint16_t stream_bytes;
+static uint8_t stream_sequence=0;
+static uint8_t stream_bank=STREAM_IDLE;
+static uint8_t stream_position;
+static uint8_t stream_flags;
+static uint8_t stream_key_count=0;
+
+/**
+*   Function for setting how often the screen is streamed.
+*
+*   Parameters:
+*           fps: Frames per second, 0 stops the stream.
+*
+*   Note: The next frame sent is always a keyframe.
+*/
+void screen_stream_set_rate(uint8_t fps)
+{
+    screen_stream_fps = fps;
+    if(fps)
+    {
+        stream_interval = STREAM_TICKS_PER_SECOND / fps;
+    }
+    stream_key_count = 0;
+    stream_bank = STREAM_IDLE;
+    stream_chunk_length = 0;
+}
+
+/**
+*   Function for working out the change to one bank since it was last sent,
+*   the shadow copy is brought up to date at the same time.
+*
+*   Returns: Non zero if there is anything to send for the bank.
+*/
+static uint8_t load_bank(uint8_t bank)
+{
+    uint8_t * screen = &screen_buffer[bank*LCD_X];
+    uint8_t * shadow = &stream_shadow[bank*LCD_X];
+    uint8_t changed = stream_flags & STREAM_KEY;
+
+    for(uint8_t i=0; i<LCD_X; i++)
+    {
+        stream_delta[i] = screen[i] ^ shadow[i];
+        changed |= stream_delta[i];
+        shadow[i] = screen[i];
+    }
+    return changed;
+}
+
+/**
+*   Returns the number of times the delta byte at position repeats.
+*/
+static uint8_t run_length(uint8_t position)
+{
+    uint8_t length = 1;
+    while(position+length < LCD_X && length < STREAM_RUN_MAX
+          && stream_delta[position+length] == stream_delta[position])
+    {
+        length++;
+    }
+    return length;
+}
+
+/**
+*   Function for starting a chunk in the staging buffer.
+*/
+static void begin_chunk(uint8_t flags)
+{
+    stream_chunk[0] = STREAM_MAGIC;
+    stream_chunk[1] = stream_sequence;
+    stream_chunk[2] = flags;
+    stream_chunk_length = STREAM_HEADER_SIZE;
+}
+
+/**
+*   Function for filling in the length and checksum of the staged chunk.
+*/
+static void end_chunk()
+{
+    uint8_t sum = 0;
+    stream_chunk[3] = stream_chunk_length - STREAM_HEADER_SIZE;
+    for(uint8_t i=0; i<stream_chunk_length; i++)
+    {
+        sum += stream_chunk[i];
+    }
+    stream_chunk[stream_chunk_length++] = sum;
+}
+
+/**
+*   Function for encoding as much of the current bank as fits in one chunk.
+*/
+static void encode_chunk()
+{
+    begin_chunk(stream_bank | stream_flags);
+    stream_flags &= ~STREAM_BANK_START;
+
+    while(stream_position < LCD_X)
+    {
+        uint8_t room = STREAM_HEADER_SIZE + STREAM_PAYLOAD_MAX - stream_chunk_length;
+        uint8_t run = run_length(stream_position);
+
+        if(run >= STREAM_RUN_MIN)
+        {
+            if(room < 2)
+                break;
+            stream_chunk[stream_chunk_length++] = 0x80 | (run-1);
+            stream_chunk[stream_chunk_length++] = stream_delta[stream_position];
+            stream_position += run;
+        }
+        else
+        {
+            // Collect bytes until the next worthwhile run
+            uint8_t length = run;
+            while(stream_position+length < LCD_X && length < STREAM_LITERAL_MAX
+                  && run_length(stream_position+length) < STREAM_RUN_MIN)
+            {
+                length++;
+            }
+            if(room < 2)
+                break;
+            if(length > room-1)
+                length = room-1;
+            stream_chunk[stream_chunk_length++] = length-1;
+            memcpy(&stream_chunk[stream_chunk_length], &stream_delta[stream_position], length);
+            stream_chunk_length += length;
+            stream_position += length;
+        }
+    }
+    end_chunk();
+}
+
+/**
+*   Function for staging the next chunk of the frame being sent, after the
+*   last bank the frame end chunk is staged and the frame is marked done.
+*/
+static void next_chunk()
+{
+    while(stream_bank < STREAM_BANKS)
+    {
+        if(stream_position == STREAM_NEXT_BANK)
+        {
+            if(load_bank(stream_bank))
+            {
+                stream_position = 0;
+                stream_flags |= STREAM_BANK_START;
+            }
+            else
+            {
+                stream_bank++;
+                continue;
+            }
+        }
+        if(stream_position < LCD_X)
+        {
+            encode_chunk();
+            return;
+        }
+        stream_bank++;
+        stream_position = STREAM_NEXT_BANK;
+    }
+
+    begin_chunk(STREAM_FRAME_END | STREAM_BANK_MASK);
+    stream_chunk[stream_chunk_length++] = stream_bytes & 0xFF;
+    stream_chunk[stream_chunk_length++] = stream_bytes >> 8;
+    end_chunk();
+    stream_bank = STREAM_DONE;
+}
+
+/**
+*   Function for streaming the screen buffer, called once per pass of the main
+*   loop after show_screen. A chunk is only written when the USB transmit
+*   buffer has room for all of it, so this never waits on the host and just
+*   carries on from where it left off next time.
+*
+*   Parameters:
+*           now: The current tick count.
+*
+*   Note: Each bank is captured when its first chunk is encoded, so on a busy
+*         link the banks of one streamed frame may come from different game
+*         frames. The viewer is always left matching the shadow copy.
+*/
+void screen_stream_poll(uint16_t now)
+{
+    // A throughput test has the port to itself, the frame carries on after.
+    if(!screen_stream_fps || throughput_active())
+        return;
+
+    if(stream_bank == STREAM_IDLE)
+    {
+        if((uint16_t)(now - stream_last) < stream_interval)
+            return;
+        stream_last = now;
+        stream_sequence++;
+        stream_bytes = 0;
+        stream_bank = 0;
+        stream_position = STREAM_NEXT_BANK;
+        stream_flags = 0;
+        if(stream_key_count == 0)
+        {
+            // Diffing against a blank screen sends the whole thing
+            memset(stream_shadow, 0, sizeof(stream_shadow));
+            stream_flags = STREAM_KEY;
+        }
+        stream_key_count = (stream_key_count+1) % STREAM_KEY_INTERVAL;
+    }
+
+    for(;;)
+    {
+        if(stream_chunk_length == 0)
+        {
+            next_chunk();
+        }
+        if(usb_serial_write_room() < stream_chunk_length)
+            return;
+        usb_serial_write(stream_chunk, stream_chunk_length);
+        stream_bytes += stream_chunk_length;
+        stream_chunk_length = 0;
+
+        if(stream_bank == STREAM_DONE)
+        {
+            screen_stream_frame_bytes = stream_bytes;
+            screen_stream_frames++;
+            stream_bank = STREAM_IDLE;
+            return;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+// Wire format, every chunk fits in one 64 byte USB packet and is written in
+// a single call so other serial output can only land between chunks:
+//
+//      STREAM_MAGIC, sequence, flags, length, payload[length], checksum
+//
+// flags holds the bank (0-5) in the low bits. The payload of a bank chunk is
+// RLE tokens decoding to bytes that are XORed into the bank, continuing
+// from where the last chunk of that bank left off:
+//      0x00-0x7F: literal, the next (token+1) bytes.
+//      0x80-0xFF: run, the next byte repeated ((token&0x7F)+1) times.
+// The checksum is the 8 bit sum of every byte before it in the chunk.
+#define STREAM_MAGIC 0xA5
+#define STREAM_BANK_MASK 0x07
+#define STREAM_KEY 0x10         // Keyframe, clear the bank before applying
+#define STREAM_BANK_START 0x40  // First chunk of a bank, decode from column 0
+#define STREAM_FRAME_END 0x80   // Frame done, payload is its size in bytes (LE)
+#define STREAM_HEADER_SIZE 4
+#define STREAM_CHUNK_SIZE 64
+#define STREAM_PAYLOAD_MAX (STREAM_CHUNK_SIZE-STREAM_HEADER_SIZE-1)
+
+// Default frame rate, overridable with "make STREAM_FPS=n".
+#ifndef STREAM_FPS
+#define STREAM_FPS 5
+#endif
+
+// Screen streaming only exists when built with "make SCREEN_STREAM=1" as the
+// copy of the last frame sent costs a full screen buffer of RAM.
+#ifdef SCREEN_STREAM
+extern uint8_t screen_stream_fps;
+extern uint16_t screen_stream_frames;
+extern uint16_t screen_stream_frame_bytes;
+
+#define screen_stream_running() (screen_stream_fps != 0)
+
+void screen_stream_set_rate(uint8_t fps);
+void screen_stream_poll(uint16_t now);
+#else
+#define screen_stream_running() 0
+#define screen_stream_set_rate(fps)
+#define screen_stream_poll(now)
+#endif
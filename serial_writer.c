@@ -0,0 +1,126 @@
+#include <stdint.h>
+#include "usb_serial.h"
+#include "serial_writer.h"
+#include "throughput.h"
+
+// Staging buffer for outgoing serial data, it is only ever handed to
+// usb_serial_write when it holds a full packet or when committed.
+static uint8_t packet_buffer[SERIAL_PACKET_SIZE];
+static uint8_t packet_fill=0;
+
+uint16_t serial_packets_sent=0;
+
+/**
+*   Function for handing the staging buffer to the USB endpoint, it is
+*   dropped instead while a throughput test has the port.
+*/
+static void flush_packet()
+{
+    if(packet_fill>0)
+    {
+        if(!throughput_active())
+        {
+            usb_serial_write(packet_buffer, packet_fill);
+            serial_packets_sent++;
+        }
+        packet_fill=0;
+    }
+}
+
+/**
+*   Function for appending a single byte to the staging buffer, the buffer is
+*   sent as soon as it holds a full packet.
+*/
+static inline void append_byte(uint8_t byte)
+{
+    packet_buffer[packet_fill++]=byte;
+    if(packet_fill==SERIAL_PACKET_SIZE)
+    {
+        flush_packet();
+    }
+}
+
+/**
+*   Function for appending a null terminated string to the staging buffer.
+*
+*   Parameters:
+*           message: The string to be appended, the null is not sent.
+*/
+void serial_writer_append(const char * message)
+{
+    while(*message)
+    {
+        append_byte(*message++);
+    }
+}
+
+/**
+*   Function for appending raw bytes to the staging buffer.
+*
+*   Parameters:
+*           bytes: A pointer to the first byte to be sent.
+*           length: The number of bytes to be sent.
+*/
+void serial_writer_append_bytes(const uint8_t * bytes, uint16_t length)
+{
+    while(length--)
+    {
+        append_byte(*bytes++);
+    }
+}
+
+/**
+*   Function for appending the decimal representation of an unsigned integer
+*   to the staging buffer, formatted in place rather than through snprintf.
+*
+*   Parameters:
+*           value: The integer to be appended.
+*/
+void serial_writer_append_uint(uint16_t value)
+{
+    // Largest uint16_t is 5 digits long
+    char digits[5];
+    uint8_t n=0;
+
+    do
+    {
+        digits[n++] = '0' + value%10;
+        value /= 10;
+    }
+    while(value);
+
+    while(n)
+    {
+        append_byte(digits[--n]);
+    }
+}
+
+/**
+*   Function for appending the decimal representation of a signed integer
+*   to the staging buffer.
+*
+*   Parameters:
+*           value: The integer to be appended.
+*/
+void serial_writer_append_int(int16_t value)
+{
+    if(value<0)
+    {
+        append_byte('-');
+        serial_writer_append_uint(-(int32_t)value);
+    }
+    else
+        serial_writer_append_uint(value);
+}
+
+/**
+*   Function for sending whatever is left in the staging buffer and releasing
+*   the endpoint so the host receives it straight away instead of after the
+*   flush timeout.
+*/
+void serial_writer_commit()
+{
+    flush_packet();
+    if(!throughput_active())
+        usb_serial_flush_output();
+}
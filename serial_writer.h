@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+// Size of a full USB packet on the CDC transmit endpoint, this has to
+// match CDC_TX_SIZE in usb_serial.c so that every flush of the staging
+// buffer lines up with exactly one packet.
+#define SERIAL_PACKET_SIZE 64
+
+// Number of calls made to usb_serial_write by the writer (one per packet).
+extern uint16_t serial_packets_sent;
+
+void serial_writer_append(const char * message);
+void serial_writer_append_bytes(const uint8_t * bytes, uint16_t length);
+void serial_writer_append_int(int16_t value);
+void serial_writer_append_uint(uint16_t value);
+void serial_writer_commit(void);
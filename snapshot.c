@@ -0,0 +1,297 @@
+#include <stdint.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "snapshot.h"
+
+static uint8_t snapshot_buffer[SNAPSHOT_SIZE_MAX];
+static uint8_t EEMEM snapshot_store[SNAPSHOT_EEPROM_SIZE];
+
+static uint8_t snapshot_mode;
+static uint8_t snapshot_overflow;
+static uint16_t snapshot_position;
+static uint16_t snapshot_crc;
+
+// Steps of the EEPROM copy done and to do, one byte is written per step.
+static uint16_t snapshot_store_step;
+static uint16_t snapshot_store_steps=0;
+
+/**
+*   Function for starting a pass over the fields of a snapshot, every field
+*   function after this either saves the variable or loads it.
+*
+*   Parameters:
+*           mode: SNAPSHOT_SAVE or SNAPSHOT_LOAD.
+*
+*   Note: Always check a snapshot with snapshot_check before loading it, a
+*         load pass writes each variable as it goes.
+*/
+void snapshot_begin(uint8_t mode)
+{
+    snapshot_mode = mode;
+    snapshot_overflow = 0;
+    snapshot_position = SNAPSHOT_HEADER_SIZE;
+    snapshot_crc = 0xFFFF;
+}
+
+/**
+*   Returns non zero during a load pass.
+*/
+uint8_t snapshot_loading()
+{
+    return snapshot_mode == SNAPSHOT_LOAD;
+}
+
+/**
+*   Function for saving or loading a single byte at the current position.
+*/
+static uint8_t transfer_byte(uint8_t byte)
+{
+    if(snapshot_position >= SNAPSHOT_SIZE_MAX)
+    {
+        snapshot_overflow = 1;
+        return byte;
+    }
+    if(snapshot_mode == SNAPSHOT_SAVE)
+        snapshot_buffer[snapshot_position] = byte;
+    else
+        byte = snapshot_buffer[snapshot_position];
+    snapshot_position++;
+    snapshot_crc = _crc16_update(snapshot_crc, byte);
+    return byte;
+}
+
+/**
+*   Function for saving or loading a number of bytes, least significant first.
+*/
+static uint32_t transfer(uint32_t value, uint8_t size)
+{
+    uint32_t result = 0;
+    for(uint8_t i=0; i<size; i++)
+    {
+        result |= (uint32_t)transfer_byte(value >> (8*i)) << (8*i);
+    }
+    return result;
+}
+
+void snapshot_u8(uint8_t * value)
+{
+    *value = transfer(*value, 1);
+}
+
+void snapshot_u16(uint16_t * value)
+{
+    *value = transfer(*value, 2);
+}
+
+void snapshot_int(int * value)
+{
+    *value = (int16_t)transfer((uint16_t)*value, 2);
+}
+
+/**
+*   Function for saving or loading a double as 16 bit fixed point.
+*
+*   Parameters:
+*           value: The variable.
+*           fraction_bits: Bits after the point, 8 gives positions to 1/256
+*                          of a pixel in -128 to 128, 12 suits values under 8
+*                          like velocities and headings.
+*/
+void snapshot_q16(double * value, uint8_t fraction_bits)
+{
+    double scale = (double)((uint16_t)1 << fraction_bits);
+    int32_t fixed = (int32_t)(*value * scale + (*value < 0 ? -0.5 : 0.5));
+    if(fixed > INT16_MAX)
+        fixed = INT16_MAX;
+    if(fixed < INT16_MIN)
+        fixed = INT16_MIN;
+    fixed = (int16_t)transfer((uint16_t)fixed, 2);
+    if(snapshot_mode == SNAPSHOT_LOAD)
+        *value = fixed / scale;
+}
+
+/**
+*   Function for saving or loading a double as 16.16 fixed point, for long
+*   running timers like the game time.
+*/
+void snapshot_q32(double * value)
+{
+    int32_t fixed = (int32_t)(*value * 65536.0 + (*value < 0 ? -0.5 : 0.5));
+    fixed = (int32_t)transfer((uint32_t)fixed, 4);
+    if(snapshot_mode == SNAPSHOT_LOAD)
+        *value = fixed / 65536.0;
+}
+
+/**
+*   Function for finishing a pass, a save pass writes the header last so a
+*   snapshot cut short never looks valid.
+*
+*   Returns: The length of the blob, 0 if it did not fit in the buffer.
+*/
+uint16_t snapshot_end(uint16_t layout)
+{
+    if(snapshot_overflow)
+        return 0;
+    if(snapshot_mode == SNAPSHOT_SAVE)
+    {
+        uint8_t header[SNAPSHOT_HEADER_SIZE] =
+        {
+            SNAPSHOT_MAGIC, SNAPSHOT_VERSION,
+            layout & 0xFF, layout >> 8,
+            snapshot_position & 0xFF, snapshot_position >> 8,
+            snapshot_crc & 0xFF, snapshot_crc >> 8
+        };
+        memcpy(snapshot_buffer, header, SNAPSHOT_HEADER_SIZE);
+    }
+    return snapshot_position;
+}
+
+/**
+*   Returns the length of the blob in the buffer, 0 unless it has the magic
+*   and version, a length that fits and fields that match the crc.
+*/
+static uint16_t snapshot_valid()
+{
+    const uint8_t * header = snapshot_buffer;
+    uint16_t length = header[4] | (header[5] << 8);
+    if(header[0] != SNAPSHOT_MAGIC || header[1] != SNAPSHOT_VERSION
+       || length < SNAPSHOT_HEADER_SIZE || length > SNAPSHOT_SIZE_MAX)
+        return 0;
+
+    uint16_t crc = 0xFFFF;
+    for(uint16_t i=SNAPSHOT_HEADER_SIZE; i<length; i++)
+    {
+        crc = _crc16_update(crc, snapshot_buffer[i]);
+    }
+    if(crc != (header[6] | (header[7] << 8)))
+        return 0;
+    return length;
+}
+
+/**
+*   Function for checking the snapshot in the buffer before it is loaded.
+*
+*   Parameters:
+*           layout: The layout the game expects, see snapshot.h.
+*
+*   Returns: The length of the blob, 0 if there is no valid snapshot for
+*            this version and layout.
+*/
+uint16_t snapshot_check(uint16_t layout)
+{
+    if((snapshot_buffer[2] | (snapshot_buffer[3] << 8)) != layout)
+        return 0;
+    return snapshot_valid();
+}
+
+/**
+*   Function for reading the raw blob, used to send a snapshot to the host.
+*
+*   Returns: The number of bytes read, less than count at the end.
+*/
+uint8_t snapshot_read(uint16_t offset, uint8_t * bytes, uint8_t count)
+{
+    if(offset >= SNAPSHOT_SIZE_MAX)
+        return 0;
+    if(offset + count > SNAPSHOT_SIZE_MAX)
+        count = SNAPSHOT_SIZE_MAX - offset;
+    memcpy(bytes, &snapshot_buffer[offset], count);
+    return count;
+}
+
+/**
+*   Function for writing the raw blob, used to receive a snapshot from the
+*   host. Nothing is checked until snapshot_check.
+*
+*   Returns: The number of bytes written, less than count at the end.
+*/
+uint8_t snapshot_write(uint16_t offset, const uint8_t * bytes, uint8_t count)
+{
+    if(offset >= SNAPSHOT_SIZE_MAX)
+        return 0;
+    if(offset + count > SNAPSHOT_SIZE_MAX)
+        count = SNAPSHOT_SIZE_MAX - offset;
+    memcpy(&snapshot_buffer[offset], bytes, count);
+    return count;
+}
+
+/**
+*   Function for starting to copy the snapshot in the buffer to EEPROM,
+*   snapshot_store_poll does the writing. The buffer must be left alone
+*   until snapshot_store_left gives 0.
+*
+*   Returns: The length of the blob, 0 if the buffer holds no valid
+*            snapshot or it does not fit in the EEPROM.
+*/
+uint16_t snapshot_store_start()
+{
+    uint16_t length = snapshot_valid();
+    if(length > SNAPSHOT_EEPROM_SIZE)
+        return 0;
+    snapshot_store_step = 0;
+    snapshot_store_steps = length ? length+1 : 0;
+    return length;
+}
+
+/**
+*   Returns the number of EEPROM bytes the copy still has to write, 0 when
+*   there is no copy under way.
+*/
+uint16_t snapshot_store_left()
+{
+    return snapshot_store_steps - snapshot_store_step;
+}
+
+/**
+*   Function for writing the next byte of the EEPROM copy, called every
+*   frame. Nothing is done while the EEPROM is still busy with the last byte
+*   so this never waits.
+*
+*   Note: The magic is cleared first and written last, a copy cut short
+*         by a reset is never taken for a snapshot by snapshot_fetch.
+*/
+void snapshot_store_poll()
+{
+    if(snapshot_store_step == snapshot_store_steps || !eeprom_is_ready())
+        return;
+
+    // Step 0 clears the magic, then the fields, the rest of the header and
+    // the magic again.
+    uint16_t fields = snapshot_store_steps - 1 - SNAPSHOT_HEADER_SIZE;
+    uint16_t step = snapshot_store_step++;
+    uint16_t address;
+    if(step == 0)
+    {
+        eeprom_update_byte(&snapshot_store[0], (uint8_t)~SNAPSHOT_MAGIC);
+        return;
+    }
+    if(step <= fields)
+        address = SNAPSHOT_HEADER_SIZE + step - 1;
+    else if(step < snapshot_store_steps - 1)
+        address = step - fields;
+    else
+        address = 0;
+    eeprom_update_byte(&snapshot_store[address], snapshot_buffer[address]);
+}
+
+/**
+*   Function for reading the snapshot kept in EEPROM back into the buffer.
+*
+*   Returns: The length of the blob, 0 if the EEPROM holds no valid
+*            snapshot or a copy to it is still under way.
+*/
+uint16_t snapshot_fetch()
+{
+    uint8_t header[SNAPSHOT_HEADER_SIZE];
+    if(snapshot_store_left())
+        return 0;
+    eeprom_read_block(header, snapshot_store, SNAPSHOT_HEADER_SIZE);
+
+    uint16_t length = header[4] | (header[5] << 8);
+    if(header[0] != SNAPSHOT_MAGIC || length < SNAPSHOT_HEADER_SIZE || length > SNAPSHOT_SIZE_MAX)
+        return 0;
+    eeprom_read_block(snapshot_buffer, snapshot_store, length);
+    return snapshot_valid();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <avr/io.h>
+#include "pool_sizes.h"
+#include "prng.h"
+
+// A snapshot is built in a RAM buffer as a header followed by the packed
+// fields:
+//
+//      magic, version, layout (2), length (2), crc (2), fields...
+//
+// length counts the whole blob including the header and the crc is CRC-16
+// (avr-libc _crc16_update) of the fields. layout is supplied by the game and
+// changes with anything that changes the field list, such as pool sizes, so
+// a snapshot is only ever loaded by a build that wrote the same fields.
+// Multi byte values are little endian.
+//
+// The host reads and writes the buffer directly over the remote protocol.
+// Keeping a snapshot in EEPROM is a separate step: snapshot_store_start
+// copies the buffer out a byte per snapshot_store_poll, as each EEPROM byte
+// takes 3.4ms, and snapshot_fetch reads it back into the buffer.
+#define SNAPSHOT_MAGIC 0x53
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_HEADER_SIZE 8
+#define SNAPSHOT_EEPROM_SIZE (E2END+1)
+
+// Most bytes snapshot_game in main.c writes, every pool full: the header, 36
+// bytes of single values, the prng state, 8 bytes per asteroid and, for the
+// other pools, a mask byte per 8 slots and 11 bytes a slot (13 for a bolt).
+#define SNAPSHOT_POOL_BYTES(slots, per_slot) (((slots)+7)/8 + (slots)*(per_slot))
+#define SNAPSHOT_SIZE_MAX (SNAPSHOT_HEADER_SIZE + 36 + 2*(PRNG_STREAMS+1) + 8*MAX_ASTEROID \
+                           + SNAPSHOT_POOL_BYTES(MAX_BOULDER, 11) \
+                           + SNAPSHOT_POOL_BYTES(MAX_FRAG, 11) \
+                           + SNAPSHOT_POOL_BYTES(MAX_PROJECTILE, 13))
+
+// Direction of a pass over the fields.
+#define SNAPSHOT_SAVE 0
+#define SNAPSHOT_LOAD 1
+
+void snapshot_begin(uint8_t mode);
+uint8_t snapshot_loading(void);
+void snapshot_u8(uint8_t * value);
+void snapshot_u16(uint16_t * value);
+void snapshot_int(int * value);
+void snapshot_q16(double * value, uint8_t fraction_bits);
+void snapshot_q32(double * value);
+uint16_t snapshot_end(uint16_t layout);
+
+uint16_t snapshot_check(uint16_t layout);
+uint8_t snapshot_read(uint16_t offset, uint8_t * bytes, uint8_t count);
+uint8_t snapshot_write(uint16_t offset, const uint8_t * bytes, uint8_t count);
+
+uint16_t snapshot_store_start(void);
+uint16_t snapshot_store_left(void);
+void snapshot_store_poll(void);
+uint16_t snapshot_fetch(void);
@@ -0,0 +1,154 @@
+#ifdef SERIAL_DEBUG
+
+#include <stdint.h>
+#include <util/atomic.h>
+#include "usb_serial.h"
+#include "throughput.h"
+
+// Ticks of the Timer0 overflow (about 488 a second).
+#define THROUGHPUT_TICKS_PER_SECOND ((uint16_t)(8000000.0 / (64.0 * 256.0)))
+
+static uint8_t throughput_running=0;
+static uint8_t throughput_chunks;
+static uint16_t throughput_length;
+static uint16_t throughput_start_tick;
+static uint16_t throughput_flushes_before;
+
+// Counts for the last test, read with throughput_result.
+static uint32_t throughput_bytes;
+static uint16_t throughput_sequence;
+static uint16_t throughput_stalls;
+static uint16_t throughput_timeouts;
+static uint16_t throughput_flushes;
+static uint16_t throughput_frames;
+static uint16_t throughput_ticks;
+
+/**
+*   Returns the flush count, read with interrupts off as the USB interrupt
+*   adds to it.
+*/
+static uint16_t throughput_flush_count(void)
+{
+    uint16_t flushes;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        flushes = usb_serial_flushes;
+    }
+    return flushes;
+}
+
+/**
+*   Function for starting a throughput test from the next frame.
+*
+*   Parameters:
+*           seconds: How long to stream for, 1 to THROUGHPUT_SECONDS_MAX.
+*           chunks_per_frame: Chunks written each frame, at least 1.
+*
+*   Returns: 0 if either is out of range.
+*/
+uint8_t throughput_start(uint8_t seconds, uint8_t chunks_per_frame)
+{
+    if(seconds == 0 || seconds > THROUGHPUT_SECONDS_MAX || chunks_per_frame == 0)
+        return 0;
+
+    throughput_chunks = chunks_per_frame;
+    throughput_length = seconds * THROUGHPUT_TICKS_PER_SECOND;
+    throughput_bytes = 0;
+    throughput_sequence = 0;
+    throughput_stalls = 0;
+    throughput_timeouts = 0;
+    throughput_frames = 0;
+    throughput_ticks = 0;
+    throughput_running = 1;
+    return 1;
+}
+
+/**
+*   Returns non zero from throughput_start until the last chunk is written.
+*/
+uint8_t throughput_active(void)
+{
+    return throughput_running;
+}
+
+/**
+*   Function for writing the counts of the last test as the
+*   REMOTE_THROUGHPUT_RESULT reply.
+*
+*   Returns: The reply length, 0 while a test is still running.
+*/
+uint8_t throughput_result(uint8_t * reply)
+{
+    if(throughput_running)
+        return 0;
+
+    uint16_t counts[] =
+    {
+        throughput_sequence, throughput_stalls, throughput_timeouts,
+        throughput_flushes, throughput_frames, throughput_ticks
+    };
+    for(uint8_t i=0; i<4; i++)
+    {
+        reply[i] = throughput_bytes >> (8*i);
+    }
+    for(uint8_t i=0; i<sizeof(counts)/sizeof(counts[0]); i++)
+    {
+        reply[4+2*i] = counts[i] & 0xFF;
+        reply[5+2*i] = counts[i] >> 8;
+    }
+    return THROUGHPUT_RESULT_SIZE;
+}
+
+/**
+*   Function for writing this frame's chunks, called once a frame so the
+*   frame count shows what streaming costs the game.
+*
+*   Parameters:
+*           now: The current tick count.
+*
+*   Note: A chunk written while the endpoint has no room waits in
+*         usb_serial_write for the host, that wait is counted as a stall.
+*         A write that gives up after TRANSMIT_TIMEOUT is a timeout and
+*         its bytes are not counted.
+*/
+void throughput_poll(uint16_t now)
+{
+    static uint8_t chunk[THROUGHPUT_CHUNK_SIZE];
+
+    if(!throughput_running)
+        return;
+    if(throughput_frames == 0)
+    {
+        throughput_start_tick = now;
+        throughput_flushes_before = throughput_flush_count();
+    }
+    throughput_frames++;
+
+    for(uint8_t i=0; i<throughput_chunks; i++)
+    {
+        uint16_t tick = now - throughput_start_tick;
+        uint8_t last = tick >= throughput_length && i == throughput_chunks-1;
+        throughput_fill(chunk, last ? THROUGHPUT_LAST : 0, throughput_sequence, tick);
+
+        if(usb_serial_write_room() < THROUGHPUT_CHUNK_SIZE)
+            throughput_stalls++;
+        if(usb_serial_write(chunk, THROUGHPUT_CHUNK_SIZE) < 0)
+        {
+            throughput_timeouts++;
+        }
+        else
+        {
+            throughput_bytes += THROUGHPUT_CHUNK_SIZE;
+        }
+        throughput_sequence++;
+
+        if(last)
+        {
+            throughput_ticks = tick;
+            throughput_flushes = throughput_flush_count() - throughput_flushes_before;
+            throughput_running = 0;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+// USB throughput test, started with REMOTE_THROUGHPUT. While it runs every
+// frame writes a number of full USB packet chunks of a known pattern:
+//
+//      THROUGHPUT_MAGIC, flags, sequence (LE), tick (LE), pattern...
+//
+// where pattern byte k of the chunk is (sequence + k) & 0xFF and tick is
+// the Timer0 tick of the frame it was written in, counted from the start. The last chunk has
+// THROUGHPUT_LAST set in flags. The counts are read back afterwards with
+// REMOTE_THROUGHPUT_RESULT.
+#define THROUGHPUT_MAGIC 0x5A
+#define THROUGHPUT_LAST 0x01
+#define THROUGHPUT_HEADER_SIZE 6
+#define THROUGHPUT_CHUNK_SIZE 64
+#define THROUGHPUT_SECONDS_MAX 60
+
+// Size of the REMOTE_THROUGHPUT_RESULT reply: uint32 bytes, then uint16
+// chunks, stalls, timeouts, flushes, frames and ticks.
+#define THROUGHPUT_RESULT_SIZE 16
+
+/**
+*   Function for filling a chunk of the test pattern, shared with the host
+*   tools so both sides agree on every byte.
+*/
+static inline void throughput_fill(uint8_t * chunk, uint8_t flags, uint16_t sequence, uint16_t tick)
+{
+    chunk[0] = THROUGHPUT_MAGIC;
+    chunk[1] = flags;
+    chunk[2] = sequence & 0xFF;
+    chunk[3] = sequence >> 8;
+    chunk[4] = tick & 0xFF;
+    chunk[5] = tick >> 8;
+    for(uint8_t k=THROUGHPUT_HEADER_SIZE; k<THROUGHPUT_CHUNK_SIZE; k++)
+    {
+        chunk[k] = sequence + k;
+    }
+}
+
+// The test is part of the remote protocol so only exists with SERIAL_DEBUG.
+// While it runs every other writer to the serial port stays quiet, so the
+// host sees nothing but chunks and the replies to the test's own commands.
+#ifdef SERIAL_DEBUG
+uint8_t throughput_start(uint8_t seconds, uint8_t chunks_per_frame);
+uint8_t throughput_active(void);
+uint8_t throughput_result(uint8_t * reply);
+void throughput_poll(uint16_t now);
+#else
+#define throughput_active() 0
+#define throughput_poll(now)
+#endif
@@ -0,0 +1,105 @@
+/*
+*   Host test of the backlight fader (backlight.h), run by "make host-test".
+*
+*   Build:  cc -O2 -Ihost -o backlight_test backlight_test.c ../backlight.c host/avr_io.c
+*   Usage:  backlight_test [-v]
+*
+*   Steps the Timer4 overflow interrupt by hand through the fades the game
+*   uses and checks the duty cycle written to TC4H:OCR4A on every tick:
+*   it only ever moves towards the target, the target is reached on the
+*   tick the duration asked for, and backlight_done is only true from then
+*   on. -v prints the trace, every 8th tick.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "avr/io.h"
+#include "../backlight.h"
+
+#define TRACE_EVERY 8
+
+void TIMER4_OVF_vect(void);
+
+static int failures = 0;
+static int verbose = 0;
+
+static void expect(int ok, const char * what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+static uint16_t duty(void)
+{
+    return (uint16_t)TC4H << 8 | OCR4A;
+}
+
+/**
+*   Function for running a fade from one level to another and checking the
+*   duty cycle trace it leaves.
+*/
+static void check_fade(const char * name, uint8_t from, uint8_t to, uint16_t duration)
+{
+    char what[80];
+    uint16_t start, target;
+
+    backlight_init(to);
+    target = duty();
+    backlight_init(from);
+    start = duty();
+    backlight_fade(to, duration);
+
+    int towards = 1, done_early = 0;
+    uint16_t previous = start, ticks = 0;
+    if(verbose)
+        printf("%s: tick duty\n", name);
+    while(!backlight_done() && ticks < 4 * duration + 4)
+    {
+        TIMER4_OVF_vect();
+        ticks++;
+        uint16_t now = duty();
+        towards &= target > start ? now >= previous : now <= previous;
+        previous = now;
+        if(verbose && (ticks % TRACE_EVERY == 0 || now == target))
+            printf("%s: %4u %4u\n", name, ticks, now);
+        done_early |= backlight_done() && now != target;
+    }
+
+    snprintf(what, sizeof(what), "%s: duty %u to %u only moves one way", name, start, target);
+    expect(towards, what);
+    snprintf(what, sizeof(what), "%s: reached in %u ticks of %u", name, ticks, duration);
+    expect(duty() == target && ticks == (duration ? duration : 1), what);
+    snprintf(what, sizeof(what), "%s: done only once there", name);
+    expect(!done_early, what);
+
+    TIMER4_OVF_vect();
+    snprintf(what, sizeof(what), "%s: stays put after", name);
+    expect(duty() == target && backlight_done(), what);
+}
+
+int main(int argc, char ** argv)
+{
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    backlight_init(BACKLIGHT_FULL);
+    expect(duty() == 0 && (TIMSK4 & (1<<TOIE4)), "init at full: duty 0, overflow interrupt on");
+
+    // The fades the game does: dim at game over, light up after it and at
+    // power on.
+    check_fade("dim", BACKLIGHT_FULL, BACKLIGHT_OFF, BACKLIGHT_TICKS(2));
+    check_fade("light", BACKLIGHT_OFF, BACKLIGHT_FULL, BACKLIGHT_TICKS(2));
+    check_fade("short", 40, 20, 3);
+    check_fade("instant", BACKLIGHT_OFF, BACKLIGHT_FULL, 0);
+    check_fade("slow", BACKLIGHT_FULL, 60, 1000);
+
+    // A fade started part way through another goes from where it got to.
+    backlight_init(BACKLIGHT_OFF);
+    backlight_fade(BACKLIGHT_FULL, BACKLIGHT_TICKS(2));
+    for(int i=0; i<100; i++)
+        TIMER4_OVF_vect();
+    uint16_t midway = duty();
+    backlight_fade(BACKLIGHT_OFF, BACKLIGHT_TICKS(1));
+    TIMER4_OVF_vect();
+    expect(duty() >= midway && duty() < 1023, "a new fade carries on from the old one");
+    return failures != 0;
+}
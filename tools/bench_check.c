@@ -0,0 +1,457 @@
+/*
+*   Host side checker for "make bench", compares the benchmark results against
+*   a baseline file and fails if any of them got worse by more than its
+*   tolerance.
+*
+*   Build:  cc -O2 -o bench_check bench_check.c
+*   Usage:  bench_check <baseline.json> <scene>... < results
+*           bench_check -u <baseline.json> <scene>... < results
+*
+*   The results are the lines printed by the BENCHMARK build in simavr,
+*
+*           bench scene=wave frames=150 cycles_per_frame=123 isr_max=45 stack=67
+*           bench scene=prng_next ops=1000 cycles_per_op=30
+*           ...
+*           bench done
+*
+*   and a size line made from avr-size by the makefile,
+*
+*           size flash=20300 ram=2300
+*
+*   anything else (simavr's own messages) is skipped. The baseline is
+*
+*           {
+*               "tolerance": { "cycles_per_frame": 2, ... },
+*               "size": { "flash": 20300, "ram": 2300 },
+*               "scenes": { "wave": { "cycles_per_frame": 123, ... }, ... }
+*           }
+*
+*   where tolerances are the percent a metric may grow by. rocks, the most
+*   rocks a scene had falling, is the other way round and may only shrink
+*   by its tolerance, as a scene with fewer rocks is timing less. Every
+*   scene named on the command line must have reported and the run must
+*   have got to "bench done". Once a baseline has been recorded every metric measured
+*   must have a value in it. A baseline holding only tolerances has not been
+*   recorded yet, the results are printed but nothing fails on them. -u
+*   writes the results back to the baseline keeping its tolerances, after a
+*   change that is meant to cost more or on the first run with simavr, and
+*   refuses to when the run is incomplete.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define METRICS_MAX 256
+#define PATH_MAX_LENGTH 96
+
+// Tolerance used for a metric the baseline does not give one for.
+#define DEFAULT_TOLERANCE 0.0
+
+typedef struct
+{
+    char path[PATH_MAX_LENGTH];
+    double value;
+} metric_t;
+
+typedef struct
+{
+    metric_t items[METRICS_MAX];
+    int count;
+} metrics_t;
+
+static metrics_t baseline, results;
+
+static void metrics_put(metrics_t * metrics, const char * path, double value)
+{
+    for(int i=0; i<metrics->count; i++)
+    {
+        if(strcmp(metrics->items[i].path, path) == 0)
+        {
+            metrics->items[i].value = value;
+            return;
+        }
+    }
+    if(metrics->count == METRICS_MAX)
+    {
+        fprintf(stderr, "too many metrics\n");
+        exit(2);
+    }
+    snprintf(metrics->items[metrics->count].path, PATH_MAX_LENGTH, "%s", path);
+    metrics->items[metrics->count++].value = value;
+}
+
+/**
+*   Returns the metric at path, NULL if there is none.
+*/
+static const metric_t * metrics_get(const metrics_t * metrics, const char * path)
+{
+    for(int i=0; i<metrics->count; i++)
+    {
+        if(strcmp(metrics->items[i].path, path) == 0)
+            return &metrics->items[i];
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+//  Baseline reading, just enough JSON for nested objects of numbers.
+// ---------------------------------------------------------------------------
+
+static const char * json;
+static const char * json_file;
+
+static void json_fail(const char * what)
+{
+    fprintf(stderr, "%s: %s near \"%.20s\"\n", json_file, what, json);
+    exit(2);
+}
+
+static void json_skip(void)
+{
+    while(isspace((unsigned char)*json))
+        json++;
+}
+
+static void json_expect(char c)
+{
+    json_skip();
+    if(*json != c)
+        json_fail("unexpected character");
+    json++;
+}
+
+static void json_string(char * out, int size)
+{
+    int n = 0;
+    json_expect('"');
+    while(*json && *json != '"')
+    {
+        if(n < size-1)
+            out[n++] = *json;
+        json++;
+    }
+    out[n] = '\0';
+    json_expect('"');
+}
+
+/**
+*   Function for reading a value and everything inside it, numbers are put
+*   in the baseline under their dotted path.
+*/
+static void json_value(const char * path)
+{
+    json_skip();
+    if(*json == '{')
+    {
+        json++;
+        json_skip();
+        if(*json == '}')
+        {
+            json++;
+            return;
+        }
+        for(;;)
+        {
+            char key[PATH_MAX_LENGTH], child[2*PATH_MAX_LENGTH];
+            json_string(key, sizeof(key));
+            json_expect(':');
+            snprintf(child, sizeof(child), "%s%s%s", path, *path ? "." : "", key);
+            json_value(child);
+            json_skip();
+            if(*json == ',')
+            {
+                json++;
+                continue;
+            }
+            json_expect('}');
+            return;
+        }
+    }
+    char * end;
+    double value = strtod(json, &end);
+    if(end == json)
+        json_fail("expected a number");
+    json = end;
+    metrics_put(&baseline, path, value);
+}
+
+static void read_baseline(const char * file)
+{
+    static char text[16384];
+    FILE * in = fopen(file, "r");
+    if(!in)
+    {
+        perror(file);
+        exit(2);
+    }
+    size_t length = fread(text, 1, sizeof(text)-1, in);
+    fclose(in);
+    text[length] = '\0';
+
+    json = text;
+    json_file = file;
+    json_value("");
+}
+
+// ---------------------------------------------------------------------------
+//  Results
+// ---------------------------------------------------------------------------
+
+/**
+*   Function for reading every key=value pair after the start of a result
+*   line, under prefix.
+*/
+static void read_pairs(const char * pairs, const char * prefix)
+{
+    char key[PATH_MAX_LENGTH], path[2*PATH_MAX_LENGTH];
+    double value;
+    int used;
+    while(sscanf(pairs, " %63[a-z_]=%lf%n", key, &value, &used) == 2)
+    {
+        if(strcmp(key, "frames") != 0 && strcmp(key, "ops") != 0)
+        {
+            snprintf(path, sizeof(path), "%s.%s", prefix, key);
+            metrics_put(&results, path, value);
+        }
+        pairs += used;
+    }
+}
+
+// Set once the benchmark has printed its last line.
+static int finished = 0;
+
+static void read_results(void)
+{
+    char line[512];
+    while(fgets(line, sizeof(line), stdin))
+    {
+        char * found;
+        char scene[32];
+        int used;
+        if((found = strstr(line, "bench scene=")) != NULL
+           && sscanf(found, "bench scene=%31s%n", scene, &used) == 1)
+        {
+            char prefix[PATH_MAX_LENGTH];
+            snprintf(prefix, sizeof(prefix), "scenes.%s", scene);
+            read_pairs(found + used, prefix);
+        }
+        else if((found = strstr(line, "size ")) == line)
+        {
+            read_pairs(found + 5, "size");
+        }
+        else if(strstr(line, "bench done"))
+        {
+            finished = 1;
+        }
+    }
+}
+
+/**
+*   Returns the last part of a dotted path.
+*/
+static const char * leaf(const char * path)
+{
+    const char * dot = strrchr(path, '.');
+    return dot ? dot+1 : path;
+}
+
+static double tolerance(const char * path)
+{
+    char name[PATH_MAX_LENGTH];
+    snprintf(name, sizeof(name), "tolerance.%s", leaf(path));
+    const metric_t * found = metrics_get(&baseline, name);
+    return found ? found->value : DEFAULT_TOLERANCE;
+}
+
+/**
+*   Returns whether the metric gets worse by shrinking rather than growing.
+*/
+static int is_floor(const char * path)
+{
+    return strcmp(leaf(path), "rocks") == 0;
+}
+
+// ---------------------------------------------------------------------------
+//  Checking and updating
+// ---------------------------------------------------------------------------
+
+/**
+*   Returns whether the baseline holds any results rather than only the
+*   tolerances.
+*/
+static int recorded(void)
+{
+    for(int i=0; i<baseline.count; i++)
+    {
+        if(strncmp(baseline.items[i].path, "tolerance.", 10) != 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+*   Returns the number of the scenes given that did not report any metrics,
+*   and whether the run did not get to the end, printing each.
+*/
+static int incomplete(char ** scenes, int count)
+{
+    int failed = 0;
+    for(int i=0; i<count; i++)
+    {
+        char prefix[PATH_MAX_LENGTH];
+        int found = 0;
+        snprintf(prefix, sizeof(prefix), "scenes.%s.", scenes[i]);
+        for(int j=0; j<results.count && !found; j++)
+            found = strncmp(results.items[j].path, prefix, strlen(prefix)) == 0;
+        if(!found)
+        {
+            printf("scene %s did not report\n", scenes[i]);
+            failed++;
+        }
+    }
+    if(!finished)
+    {
+        printf("the benchmark did not get to the end\n");
+        failed++;
+    }
+    return failed;
+}
+
+/**
+*   Returns the number of metrics that regressed, went missing or have no
+*   recorded value.
+*/
+static int check(void)
+{
+    int failed = 0;
+    printf("%-36s %10s %10s %8s\n", "metric", "baseline", "now", "change");
+    for(int i=0; i<results.count; i++)
+    {
+        const metric_t * now = &results.items[i];
+        const metric_t * base = metrics_get(&baseline, now->path);
+        if(!base)
+        {
+            printf("%-36s %10s %10.0f %8s  UNRECORDED\n", now->path, "-", now->value, "");
+            failed++;
+            continue;
+        }
+        double change = base->value ? (now->value - base->value) * 100 / base->value : 0;
+        int regressed = is_floor(now->path)
+                        ? now->value < base->value * (100 - tolerance(now->path)) / 100
+                        : now->value > base->value * (100 + tolerance(now->path)) / 100;
+        printf("%-36s %10.0f %10.0f %+7.1f%%%s\n", now->path, base->value, now->value,
+               change, regressed ? "  REGRESSED" : "");
+        failed += regressed;
+    }
+
+    // Everything in the baseline must still be measured, a scene that went
+    // missing most likely crashed.
+    for(int i=0; i<baseline.count; i++)
+    {
+        const char * path = baseline.items[i].path;
+        if(strncmp(path, "tolerance.", 10) != 0 && !metrics_get(&results, path))
+        {
+            printf("%-36s %10.0f %10s %8s  MISSING\n", path, baseline.items[i].value, "-", "");
+            failed++;
+        }
+    }
+    return failed;
+}
+
+/**
+*   Function for writing the results to the baseline file with the
+*   tolerances it already had.
+*/
+static void update(const char * file)
+{
+    FILE * out = fopen(file, "w");
+    if(!out)
+    {
+        perror(file);
+        exit(2);
+    }
+
+    fprintf(out, "{\n    \"tolerance\": {");
+    int first = 1;
+    for(int i=0; i<baseline.count; i++)
+    {
+        if(strncmp(baseline.items[i].path, "tolerance.", 10) == 0)
+        {
+            fprintf(out, "%s\n        \"%s\": %g", first ? "" : ",", leaf(baseline.items[i].path),
+                    baseline.items[i].value);
+            first = 0;
+        }
+    }
+
+    fprintf(out, "\n    },\n    \"size\": {");
+    first = 1;
+    for(int i=0; i<results.count; i++)
+    {
+        if(strncmp(results.items[i].path, "size.", 5) == 0)
+        {
+            fprintf(out, "%s\n        \"%s\": %.0f", first ? "" : ",", leaf(results.items[i].path),
+                    results.items[i].value);
+            first = 0;
+        }
+    }
+
+    // Scenes keep the order they were run in, one line each.
+    fprintf(out, "\n    },\n    \"scenes\": {");
+    char scene[PATH_MAX_LENGTH] = "";
+    first = 1;
+    for(int i=0; i<results.count; i++)
+    {
+        const char * path = results.items[i].path;
+        if(strncmp(path, "scenes.", 7) != 0)
+            continue;
+        const char * name = path + 7;
+        int name_length = leaf(path) - 1 - name;
+        if(strlen(scene) != (size_t)name_length || strncmp(scene, name, name_length) != 0)
+        {
+            fprintf(out, "%s\n        \"%.*s\": { ", *scene ? " }," : "", name_length, name);
+            snprintf(scene, sizeof(scene), "%.*s", name_length, name);
+            first = 1;
+        }
+        fprintf(out, "%s\"%s\": %.0f", first ? "" : ", ", leaf(path), results.items[i].value);
+        first = 0;
+    }
+    fprintf(out, "%s\n    }\n}\n", *scene ? " }" : "");
+    fclose(out);
+    printf("baseline %s updated\n", file);
+}
+
+int main(int argc, char ** argv)
+{
+    int updating = argc > 1 && strcmp(argv[1], "-u") == 0;
+    if(argc < 3 + updating)
+    {
+        fprintf(stderr, "usage: %s [-u] <baseline.json> <scene>... < results\n", argv[0]);
+        return 2;
+    }
+    const char * file = argv[1 + updating];
+    char ** scenes = &argv[2 + updating];
+    int scene_count = argc - 2 - updating;
+
+    read_baseline(file);
+    read_results();
+    if(incomplete(scenes, scene_count))
+    {
+        printf("incomplete benchmark run%s\n", updating ? ", baseline not written" : "");
+        return 2;
+    }
+    if(updating)
+    {
+        update(file);
+        return 0;
+    }
+    int failed = check();
+    if(!recorded())
+    {
+        printf("no results recorded in %s yet, nothing checked against it\n", file);
+        return 0;
+    }
+    if(failed)
+        printf("%d metric(s) regressed, missing or unrecorded\n", failed);
+    return failed != 0;
+}
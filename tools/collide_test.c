@@ -0,0 +1,317 @@
+/*
+*   Host test of the swept collision tests (collide.h), run by "make host-test".
+*
+*   Build:  cc -O2 -Ihost -o collide_test collide_test.c ../collide.c host/avr_io.c
+*   Usage:  collide_test
+*
+*   Runs collide_swept through the tunnelling cases it was written for: a
+*   bolt stepping over a fragment narrower than its step, a step that ends
+*   past the far edge, and paths that clip or just clear a corner. A point
+*   test at the end of each of these steps gets the first two wrong. Then
+*   random paths are checked against a reference that samples the path
+*   densely in floating point: every path the reference sees touch the box
+*   must hit, and none that stays clear of it by more than a rounding step
+*   may.
+*
+*   collide_sprite is checked against the rock sprites of main.c. A bolt
+*   standing still must hit exactly where its 2x2 pixels overlap the
+*   sprite, paths around the empty corners of the diamonds must miss, and
+*   random paths are checked against the same dense reference run on the
+*   mask cells. Then prints the host time per test, which only compares
+*   the cases with each other; the cycles on the Teensy come from the
+*   collide scenes of "make bench".
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "../collide.h"
+
+// Width of a fragment, the smallest box the game sweeps against.
+#define FRAGMENT 3
+
+#define RANDOM_PATHS 200000
+#define REFERENCE_STEPS 4096
+
+// How far outside the box a hit may come from, fixed point division rounds
+// the slab times by up to a step.
+#define REFERENCE_SLACK (1.0/64)
+
+#define TIMED_CALLS 10000000
+#define ASTEROID_SIZE 7
+
+// The rock sprites as in main.c, a byte per row with bit 7 the left column.
+static const uint8_t asteroid[] = { 0x10, 0x38, 0x7C, 0xFE, 0x7C, 0x38, 0x10 };
+static const uint8_t boulder[] = { 0x20, 0x70, 0xF8, 0x70, 0x20 };
+static const uint8_t fragment[] = { 0x40, 0xE0, 0x40 };
+
+static int failures = 0;
+
+static void expect(int ok, const char * what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+/**
+*   Returns non zero if a point at the end of the step is in the box, the
+*   test collide_swept replaced.
+*/
+static int point_in_box(fix_t x, fix_t y, fix_t size)
+{
+    return x >= 0 && x <= size && y >= 0 && y <= size;
+}
+
+/**
+*   Function for checking one path from (x0, y0) to (x1, y1) in pixels
+*   against a box of a number of pixels.
+*/
+static void check_path(const char * name, double x0, double y0, double x1, double y1,
+                       uint8_t size, int hit, int point_hit)
+{
+    char what[80];
+    fix_t x = TO_FIX(x1), y = TO_FIX(y1);
+    fix_t dx = TO_FIX(x1 - x0), dy = TO_FIX(y1 - y0);
+    snprintf(what, sizeof(what), "%s: %s", name, hit ? "hit" : "no hit");
+    expect(collide_swept(x, y, dx, dy, size*FIX_ONE) == hit, what);
+    snprintf(what, sizeof(what), "%s: end point test %s", name, point_hit ? "hits" : "misses");
+    expect(point_in_box(x, y, size*FIX_ONE) == point_hit, what);
+}
+
+/**
+*   Returns non zero if any of REFERENCE_STEPS+1 points along the path is
+*   within slack of the box.
+*/
+static int reference_hit(fix_t x, fix_t y, fix_t dx, fix_t dy, fix_t size, double slack)
+{
+    double x1 = x / (double)FIX_ONE, y1 = y / (double)FIX_ONE;
+    double ddx = dx / (double)FIX_ONE, ddy = dy / (double)FIX_ONE;
+    double far = size / (double)FIX_ONE + slack;
+    for(int k=0; k<=REFERENCE_STEPS; k++)
+    {
+        double t = (double)k / REFERENCE_STEPS;
+        double px = x1 - ddx * (1 - t), py = y1 - ddy * (1 - t);
+        if(px >= -slack && px <= far && py >= -slack && py <= far)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+*   Returns a random value of up to range pixels either way in fixed point.
+*/
+static fix_t random_fix(int range)
+{
+    return (fix_t)(rand() % (2 * range * FIX_ONE + 1)) - range * FIX_ONE;
+}
+
+static void check_random(void)
+{
+    char what[80];
+    long missed = 0, false_hits = 0;
+    srand(1);
+    for(long i=0; i<RANDOM_PATHS; i++)
+    {
+        fix_t size = (1 + rand() % 7) * FIX_ONE;
+        fix_t x = random_fix(10), y = random_fix(10);
+        fix_t dx = random_fix(5), dy = random_fix(5);
+        uint8_t hit = collide_swept(x, y, dx, dy, size);
+        missed += !hit && reference_hit(x, y, dx, dy, size, 0);
+        false_hits += hit && !reference_hit(x, y, dx, dy, size, REFERENCE_SLACK);
+    }
+    snprintf(what, sizeof(what), "%d random paths: %ld touching the box missed", RANDOM_PATHS, missed);
+    expect(missed == 0, what);
+    snprintf(what, sizeof(what), "%d random paths: %ld clear of the box hit", RANDOM_PATHS, false_hits);
+    expect(false_hits == 0, what);
+}
+
+/**
+*   Returns non zero if the pixel at column c and row r of a sprite is set.
+*/
+static int sprite_pixel(const uint8_t * rows, uint8_t size, int c, int r)
+{
+    return c >= 0 && r >= 0 && c < size && r < size && (rows[r] & (0x80 >> c));
+}
+
+/**
+*   Function for checking a bolt standing still in every cell around a
+*   sprite against its 2x2 pixels drawn from that cell.
+*/
+static void check_mask(const char * name, const uint8_t * rows, uint8_t size)
+{
+    char what[80];
+    uint8_t mask[COLLIDE_MASK_MAX];
+    collide_build_mask(rows, size, mask);
+
+    int hits = 0, wrong = 0;
+    for(int y=-3; y<size+3; y++)
+    {
+        for(int x=-3; x<size+3; x++)
+        {
+            int overlap = sprite_pixel(rows, size, x, y) || sprite_pixel(rows, size, x+1, y)
+                          || sprite_pixel(rows, size, x, y+1) || sprite_pixel(rows, size, x+1, y+1);
+            int hit = collide_sprite(x*FIX_ONE, y*FIX_ONE, 0, 0, mask, size);
+            hits += hit;
+            wrong += hit != overlap;
+        }
+    }
+    snprintf(what, sizeof(what), "%s: %d cells hit of the %d in its box, as drawn", name, hits, (size+1)*(size+1));
+    expect(wrong == 0, what);
+}
+
+/**
+*   Function for checking one bolt step against the asteroid, positions in
+*   pixels relative to its top left.
+*/
+static void check_step(const char * name, const uint8_t * mask, double x, double y, double dx, double dy, int hit)
+{
+    char what[80];
+    snprintf(what, sizeof(what), "asteroid, %s: %s", name, hit ? "hit" : "no hit");
+    expect(collide_sprite(TO_FIX(x), TO_FIX(y), TO_FIX(dx), TO_FIX(dy), mask, ASTEROID_SIZE) == hit, what);
+}
+
+/**
+*   Returns non zero if any of REFERENCE_STEPS+1 points along the path lies
+*   in a set mask cell, or within slack of one.
+*/
+static int reference_mask_hit(fix_t x, fix_t y, fix_t dx, fix_t dy, const uint8_t * mask, uint8_t size, double slack)
+{
+    double x1 = (x + FIX_ONE) / (double)FIX_ONE, y1 = (y + FIX_ONE) / (double)FIX_ONE;
+    double ddx = dx / (double)FIX_ONE, ddy = dy / (double)FIX_ONE;
+    for(int k=0; k<=REFERENCE_STEPS; k++)
+    {
+        double t = (double)k / REFERENCE_STEPS;
+        double px = x1 - ddx * (1 - t), py = y1 - ddy * (1 - t);
+        for(int c=floor(px - slack); c<=floor(px + slack); c++)
+        {
+            for(int r=floor(py - slack); r<=floor(py + slack); r++)
+            {
+                if(c >= 0 && r >= 0 && c <= size && r <= size && (mask[r] & (1 << c)))
+                    return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void check_sprite_random(const char * name, const uint8_t * rows, uint8_t size)
+{
+    char what[80];
+    uint8_t mask[COLLIDE_MASK_MAX];
+    collide_build_mask(rows, size, mask);
+
+    long missed = 0, false_hits = 0;
+    srand(2);
+    for(long i=0; i<RANDOM_PATHS; i++)
+    {
+        fix_t x = random_fix(size + 3), y = random_fix(size + 3);
+        fix_t dx = random_fix(3), dy = random_fix(3);
+        // Half of them as in the game, from a whole pixel by quarter pixels,
+        // where many paths go through the corners of cells.
+        if(i & 1)
+        {
+            x = FIX_FLOOR(x);
+            y = FIX_FLOOR(y);
+            dx &= ~(FIX_ONE/4-1);
+            dy &= ~(FIX_ONE/4-1);
+        }
+        uint8_t hit = collide_sprite(x, y, dx, dy, mask, size);
+        missed += !hit && reference_mask_hit(x, y, dx, dy, mask, size, 0);
+        false_hits += hit && !reference_mask_hit(x, y, dx, dy, mask, size, REFERENCE_SLACK);
+    }
+    snprintf(what, sizeof(what), "%s: %d random paths, %ld crossing the sprite missed", name, RANDOM_PATHS, missed);
+    expect(missed == 0, what);
+    snprintf(what, sizeof(what), "%s: %d random paths, %ld clear of it hit", name, RANDOM_PATHS, false_hits);
+    expect(false_hits == 0, what);
+}
+
+static void check_sprites(void)
+{
+    uint8_t mask[COLLIDE_MASK_MAX];
+    check_mask("asteroid", asteroid, ASTEROID_SIZE);
+    check_mask("boulder", boulder, sizeof(boulder));
+    check_mask("fragment", fragment, sizeof(fragment));
+
+    // The corners of the box around the diamond are empty, a bolt is drawn
+    // 2x2 from its top left so it reaches a row and column back.
+    collide_build_mask(asteroid, ASTEROID_SIZE, mask);
+    check_step("on the top left box corner", mask, 0, 0, 0, 0, 0);
+    check_step("on the bottom right box corner", mask, 6, 6, 0, 0, 0);
+    check_step("touching the upper left slope", mask, 2, 1, 0, 0, 1);
+    check_step("just off the upper right slope", mask, 5, 0, 0, 0, 0);
+    check_step("a row above the top tip", mask, 3, -1, 0, 0, 1);
+    check_step("two rows above the top tip", mask, 3, -2, 0, 0, 0);
+    check_step("straight up through the middle", mask, 3, -3, 0, -6, 1);
+    check_step("straight up just left of the left tip", mask, -2, -3, 0, -7, 0);
+    check_step("diagonal through the empty top right", mask, 4, -1, -3, -3, 0);
+    check_step("diagonal through the empty bottom right", mask, 7, 4, 3, -3, 0);
+    check_step("diagonal through the body", mask, 4, -2, 4, -6, 1);
+    // Cuts the corner of the tip cell of the left point by a quarter pixel,
+    // which falls between samples taken every half pixel.
+    check_step("diagonal cutting a corner under half a pixel", mask, -1.75, 3, -1, -1, 1);
+
+    check_sprite_random("asteroid", asteroid, ASTEROID_SIZE);
+    check_sprite_random("boulder", boulder, sizeof(boulder));
+    check_sprite_random("fragment", fragment, sizeof(fragment));
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+*   Function for timing a number of calls of collide_sprite against the
+*   asteroid with the bolt moving a pixel up and the given start.
+*/
+static double time_sprite(const uint8_t * mask, int x, int y, fix_t dx, fix_t dy)
+{
+    volatile uint8_t sink = 0;
+    double start = seconds();
+    for(long i=0; i<TIMED_CALLS; i++)
+        sink += collide_sprite(x*FIX_ONE, (y + (i & 1))*FIX_ONE, dx, dy, mask, ASTEROID_SIZE);
+    return (seconds() - start) * 1e9 / TIMED_CALLS;
+}
+
+static void time_tests(void)
+{
+    uint8_t mask[COLLIDE_MASK_MAX];
+    collide_build_mask(asteroid, ASTEROID_SIZE, mask);
+    printf("host time per collide_sprite: box reject %.1f ns, hit at the end %.1f ns\n",
+           time_sprite(mask, 40, 10, 0, -FIX_ONE), time_sprite(mask, 3, 2, 0, -FIX_ONE));
+    printf("host time per collide_sprite: miss after 6 cells %.1f ns\n",
+           time_sprite(mask, 7, 4, 3*FIX_ONE, -3*FIX_ONE));
+}
+
+int main(void)
+{
+    // A bolt closing 4px a frame on a 3px fragment is either side of it
+    // at the end of two frames running.
+    check_path("4px step over a 3px fragment", -0.5, 1.5, 3.5, 1.5, FRAGMENT, 1, 0);
+    check_path("4px step stopping short of it", -4.5, 1.5, -0.5, 1.5, FRAGMENT, 0, 0);
+
+    // The bolt closing 2.5px a frame on a falling fragment, from inside it
+    // as when it was only split off this frame, ends just past its edge.
+    check_path("2.5px step ending just past the box", 1.0, 2.3, 1.0, -0.2, FRAGMENT, 1, 0);
+    check_path("2.5px step passing beside it", 3.5, 2.3, 3.5, -0.2, FRAGMENT, 0, 0);
+
+    // Diagonals across the near and far corners, the points of a path that
+    // clips a corner are all outside the box and so are the ends of one
+    // that clears it, only the slab test tells them apart.
+    check_path("diagonal clipping the top left corner", -1.0, 1.5, 1.5, -1.0, FRAGMENT, 1, 0);
+    check_path("diagonal clearing the top left corner", -1.0, 0.5, 0.5, -1.0, FRAGMENT, 0, 0);
+    check_path("diagonal clipping the bottom right corner", 2.0, 3.75, 3.75, 2.0, FRAGMENT, 1, 0);
+    check_path("diagonal clearing the bottom right corner", 3.0, 4.25, 4.25, 3.0, FRAGMENT, 0, 0);
+
+    // With no motion it is the point test.
+    check_path("still inside", 1.0, 1.0, 1.0, 1.0, FRAGMENT, 1, 1);
+    check_path("still outside", -0.5, 1.0, -0.5, 1.0, FRAGMENT, 0, 0);
+
+    check_random();
+    check_sprites();
+    time_tests();
+    return failures != 0;
+}
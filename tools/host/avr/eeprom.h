@@ -0,0 +1,42 @@
+#pragma once
+
+// Host stand-in for avr-libc's <avr/eeprom.h>, EEMEM variables are ordinary
+// memory. A byte write leaves the EEPROM busy for host_eeprom_write_polls
+// calls of eeprom_is_ready, and writing while it is busy is counted in
+// host_eeprom_waits as the real one would stall the CPU there.
+#include <stdint.h>
+#include <string.h>
+
+#define EEMEM
+
+extern uint8_t host_eeprom_write_polls;
+extern uint8_t host_eeprom_busy;
+extern uint16_t host_eeprom_writes;
+extern uint16_t host_eeprom_waits;
+
+static inline uint8_t eeprom_is_ready(void)
+{
+    if(host_eeprom_busy)
+        host_eeprom_busy--;
+    return host_eeprom_busy == 0;
+}
+
+static inline uint8_t eeprom_read_byte(const uint8_t * address)
+{
+    return *address;
+}
+
+static inline void eeprom_read_block(void * destination, const void * source, size_t count)
+{
+    memcpy(destination, source, count);
+}
+
+static inline void eeprom_update_byte(uint8_t * address, uint8_t value)
+{
+    if(*address == value)
+        return;
+    host_eeprom_waits += host_eeprom_busy != 0;
+    *address = value;
+    host_eeprom_writes++;
+    host_eeprom_busy = host_eeprom_write_polls;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stand-in for avr-libc's <avr/interrupt.h>, an ISR is a plain
+// function the test calls in place of the interrupt.
+#define ISR(vector) void vector(void)
+#define sei()
+#define cli()
@@ -0,0 +1,17 @@
+#pragma once
+
+// Host stand-in for avr-libc's <avr/io.h>, just the registers the modules
+// under host test touch. They are plain variables (tools/host/avr_io.c) a
+// test can read back.
+#include <stdint.h>
+
+extern volatile uint8_t TC4H;
+extern volatile uint8_t OCR4A;
+extern volatile uint8_t TIMSK4;
+
+#define TOIE4 2
+
+extern volatile uint8_t PORTB;
+
+// Last EEPROM address of the ATmega32U4.
+#define E2END 0x3FF
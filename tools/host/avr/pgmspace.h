@@ -0,0 +1,12 @@
+#pragma once
+
+// Host stand-in for avr-libc's <avr/pgmspace.h>, flash is ordinary memory.
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_ptr(address) (*(void * const *)(address))
+#define memcpy_P memcpy
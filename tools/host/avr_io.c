@@ -0,0 +1,13 @@
+#include "avr/io.h"
+
+// The registers declared by the host <avr/io.h>.
+volatile uint8_t TC4H;
+volatile uint8_t OCR4A;
+volatile uint8_t TIMSK4;
+volatile uint8_t PORTB;
+
+// The EEPROM timing of the host <avr/eeprom.h>.
+uint8_t host_eeprom_write_polls;
+uint8_t host_eeprom_busy;
+uint16_t host_eeprom_writes;
+uint16_t host_eeprom_waits;
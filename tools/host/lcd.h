@@ -0,0 +1,6 @@
+#pragma once
+
+// Host stand-in for the cab202 library's <lcd.h>, the screen size the
+// modules under host test use.
+#define LCD_X 84
+#define LCD_Y 48
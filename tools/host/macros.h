@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stand-in for the cab202 library's <macros.h>, the bit macros the
+// modules under host test use.
+#define SET_BIT(reg, pin) (reg) |= (1 << (pin))
+#define CLEAR_BIT(reg, pin) (reg) &= ~(1 << (pin))
+#define BIT_VALUE(reg, pin) (((reg) >> (pin)) & 1)
@@ -0,0 +1,6 @@
+#pragma once
+
+// Host stand-in for avr-libc's <util/atomic.h>, host tests have no
+// interrupts to keep out so the block just runs once.
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_BLOCK(type) for(int atomic_once=1; atomic_once; atomic_once=0)
@@ -0,0 +1,156 @@
+/*
+*   Host test of the LED patterns (led_pattern.h), run by "make host-test".
+*
+*   Build:  cc -O2 -Ihost -o led_pattern_test led_pattern_test.c ../led_pattern.c host/avr_io.c
+*   Usage:  led_pattern_test [-v]
+*
+*   Steps the Timer0 overflow by hand and renders what LED0 (PORTB 2) and
+*   LED1 (PORTB 3) show as a timeline of runs, one unit being a pattern step
+*   of LED_STEP_TICKS overflows (8.192ms). The timelines are checked against
+*   the patterns: every step lasts its duration, a pattern plays as many
+*   times as asked and then leaves both LEDs off, the debug pattern a cheat
+*   starts ends by itself, and the other PORTB bits (the LCD) are left
+*   alone. -v prints one character per unit as well.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "avr/io.h"
+#include "../led_pattern.h"
+
+// Units rendered past where a pattern should have ended, to see it stay off.
+#define TAIL_UNITS 30
+#define TIMELINE_MAX 1024
+
+// PORTB bits the LCD uses, which the patterns must never touch.
+#define LCD_BITS 0xF3
+
+static int failures = 0;
+static int verbose = 0;
+
+static void expect(int ok, const char * what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+static char led_char(void)
+{
+    static const char shown[] = ".01B";
+    return shown[(PORTB >> 2) & 3];
+}
+
+/**
+*   Function for rendering what the LEDs show over a number of units, one
+*   character each: '.' off, '0' LED0, '1' LED1, 'B' both.
+*/
+static void render(char * timeline, int units)
+{
+    for(int unit=0; unit<units; unit++)
+    {
+        timeline[unit] = led_char();
+        for(int tick=0; tick<LED_STEP_TICKS; tick++)
+            led_pattern_tick();
+    }
+    timeline[units] = '\0';
+}
+
+/**
+*   Function for turning a timeline into runs such as "0x12 .x48", which is
+*   what the checks compare.
+*/
+static void runs(const char * timeline, char * out, size_t size)
+{
+    size_t used = 0;
+    out[0] = '\0';
+    while(*timeline && used < size)
+    {
+        int length = 1;
+        while(timeline[length] == *timeline)
+            length++;
+        used += snprintf(out + used, size - used, "%s%cx%d", used ? " " : "", *timeline, length);
+        timeline += length;
+    }
+}
+
+/**
+*   Function for building the runs a pattern should give when played a
+*   number of times, followed by the LEDs off.
+*/
+static void expected_runs(const led_step_t * pattern, uint8_t repeats, int units, char * out, size_t size)
+{
+    static char timeline[TIMELINE_MAX+1];
+    int at = 0;
+    for(uint8_t repeat=0; repeat<repeats; repeat++)
+    {
+        for(const led_step_t * step=pattern; step->duration; step++)
+        {
+            for(int i=0; i<step->duration && at<units; i++)
+                timeline[at++] = ".01B"[step->leds & 3];
+        }
+    }
+    while(at < units)
+        timeline[at++] = '.';
+    timeline[at] = '\0';
+    runs(timeline, out, size);
+}
+
+static int pattern_units(const led_step_t * pattern)
+{
+    int units = 0;
+    for(const led_step_t * step=pattern; step->duration; step++)
+        units += step->duration;
+    return units;
+}
+
+static void check_pattern(const char * name, const led_step_t * pattern, uint8_t repeats)
+{
+    static char timeline[TIMELINE_MAX+1], got[TIMELINE_MAX], wanted[TIMELINE_MAX];
+    char what[80];
+    int units = pattern_units(pattern) * repeats + TAIL_UNITS;
+
+    PORTB = LCD_BITS;
+    led_pattern_play(pattern, repeats);
+    render(timeline, units);
+    runs(timeline, got, sizeof(got));
+    expected_runs(pattern, repeats, units, wanted, sizeof(wanted));
+
+    if(verbose)
+        printf("%s: %s\n", name, timeline);
+    printf("%s: %s\n", name, got);
+    snprintf(what, sizeof(what), "%s: %u plays of %d units, then off", name, repeats, pattern_units(pattern));
+    expect(strcmp(got, wanted) == 0, what);
+    snprintf(what, sizeof(what), "%s: LCD bits of PORTB left alone", name);
+    expect((PORTB & LCD_BITS) == LCD_BITS, what);
+}
+
+int main(int argc, char ** argv)
+{
+    static char timeline[TIMELINE_MAX+1];
+    verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+    check_pattern("warn_left", led_warn_left, 1);
+    check_pattern("warn_right", led_warn_right, 1);
+    check_pattern("game_over x3", led_game_over, 3);
+    check_pattern("debug", led_debug, LED_DEBUG_REPEATS);
+
+    // Repeats of 0 keep going until stopped, as the game over blink does
+    // while its message is up.
+    led_pattern_play(led_game_over, 0);
+    render(timeline, pattern_units(led_game_over) * 10);
+    expect(led_char() == 'B', "game_over forever: still blinking after 10 plays");
+    led_pattern_stop();
+    render(timeline, TAIL_UNITS);
+    expect(strspn(timeline, ".") == TAIL_UNITS, "led_pattern_stop leaves both LEDs off");
+
+    // A cheat part way through a warning replaces it from the start.
+    led_pattern_play(led_warn_left, 1);
+    render(timeline, 10);
+    led_pattern_play(led_debug, LED_DEBUG_REPEATS);
+    expect(led_char() == '0', "a new pattern starts on its first step");
+    render(timeline, pattern_units(led_debug) * LED_DEBUG_REPEATS + TAIL_UNITS);
+    expect(timeline[pattern_units(led_debug) * LED_DEBUG_REPEATS - 1] == '.' &&
+           strspn(timeline + pattern_units(led_debug) * LED_DEBUG_REPEATS, ".") == TAIL_UNITS,
+           "the warning it replaced does not come back");
+    return failures != 0;
+}
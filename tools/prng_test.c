@@ -0,0 +1,279 @@
+/*
+*   Host test of the prng module (prng.h), run by "make host-test".
+*
+*   Build:  cc -O2 -o prng_test prng_test.c ../prng.c
+*   Usage:  prng_test
+*
+*   Checks that prng_range gives every value of a range from the same number
+*   of 16 bit values, that a seed replays every stream exactly, that using
+*   one stream leaves the others alone, and that a saved state resumes where
+*   it left off. prng_shuffle gets a chi-square test of how often each
+*   ordering of 3 and 4 elements comes up, and of where each element of 16
+*   and 64 ends up. Then prints the host time per call, which only compares
+*   the calls with each other; the cycles on the Teensy come from the prng
+*   and shuffle scenes of "make bench".
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../prng.h"
+
+#define REPLAY_LENGTH 1000
+#define TIMED_CALLS 10000000
+#define SHUFFLE_MAX 64
+
+// A stream repeats after 65535 draws, running more shuffles than fit in
+// that only repeats the same ones and overstates any unevenness.
+#define PRNG_PERIOD 65535L
+
+// Normal quantile for the one in a thousand chance the chi-square tests
+// are allowed to fail by.
+#define CHI_SQUARE_Z 3.09
+
+static int failures = 0;
+
+static void expect(int ok, const char * what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+/**
+*   Returns the state that prng_next turns into x, undoing each xorshift
+*   step in reverse order.
+*/
+static uint16_t xorshift_inverse(uint16_t x)
+{
+    x ^= x << 8;
+    x ^= x >> 9;
+    x ^= x << 7;
+    x ^= x << 14;
+    return x;
+}
+
+/**
+*   Function for making the next prng_next of a stream return x.
+*/
+static void prng_force(uint8_t stream, uint16_t x)
+{
+    uint16_t state[PRNG_STREAMS+1];
+    prng_get_state(state);
+    state[stream] = xorshift_inverse(x);
+    prng_set_state(state);
+}
+
+/**
+*   Function for feeding every 16 bit value the generator can give through
+*   prng_range and counting the results of those it keeps without drawing
+*   again. Every result must come from exactly 65536/n values, 0 one fewer
+*   when n is a power of two as xorshift never gives 0.
+*/
+static void check_range(uint8_t n)
+{
+    static uint32_t counts[256];
+    char what[80];
+    uint16_t state[PRNG_STREAMS+1];
+
+    memset(counts, 0, sizeof(counts));
+    for(uint32_t x=1; x<=0xFFFF; x++)
+    {
+        prng_force(PRNG_MISC, x);
+        uint8_t value = prng_range(PRNG_MISC, n);
+        prng_get_state(state);
+        if(state[PRNG_MISC] == x)
+            counts[value]++;
+    }
+
+    uint32_t share = 65536 / n;
+    int even = 1;
+    for(uint16_t value=0; value<n; value++)
+    {
+        uint32_t expected = share - (value == 0 && (n & (n-1)) == 0);
+        even &= counts[value] == expected;
+    }
+    snprintf(what, sizeof(what), "prng_range(%u) takes %u values for each result", n, share);
+    expect(even, what);
+}
+
+static void record(uint16_t seed, uint16_t out[PRNG_STREAMS][REPLAY_LENGTH])
+{
+    prng_seed(seed);
+    for(int i=0; i<REPLAY_LENGTH; i++)
+    {
+        for(uint8_t stream=0; stream<PRNG_STREAMS; stream++)
+            out[stream][i] = prng_next(stream);
+    }
+}
+
+static void check_replay(void)
+{
+    static uint16_t first[PRNG_STREAMS][REPLAY_LENGTH], again[PRNG_STREAMS][REPLAY_LENGTH];
+
+    // Seeds with the top bit set are the ones the status used to print
+    // as negative numbers.
+    record(0xBEEF, first);
+    record(0xBEEF, again);
+    expect(memcmp(first, again, sizeof(first)) == 0, "seed 48879 replays all four streams");
+    expect(prng_get_seed() == 0xBEEF, "prng_get_seed gives the seed back unsigned");
+
+    // A stream drawn from twice as often must not change what another
+    // stream gives.
+    prng_seed(0xBEEF);
+    int same = 1;
+    for(int i=0; i<REPLAY_LENGTH; i++)
+    {
+        prng_next(PRNG_WAVE);
+        prng_range(PRNG_SPLIT, 3);
+        same &= prng_next(PRNG_SPAWN) == first[PRNG_SPAWN][i];
+    }
+    expect(same, "using the wave and split streams leaves spawn alone");
+
+    // Snapshots save the state mid game and carry on from it.
+    uint16_t state[PRNG_STREAMS+1];
+    prng_seed(0xBEEF);
+    for(int i=0; i<REPLAY_LENGTH/2; i++)
+        prng_next(PRNG_MISC);
+    prng_get_state(state);
+    prng_seed(1);
+    prng_set_state(state);
+    same = 1;
+    for(int i=REPLAY_LENGTH/2; i<REPLAY_LENGTH; i++)
+        same &= prng_next(PRNG_MISC) == first[PRNG_MISC][i];
+    expect(same && prng_get_seed() == 0xBEEF, "a saved state resumes the same sequence");
+
+    record(0xBEF0, again);
+    expect(memcmp(first, again, sizeof(first)) != 0, "a different seed gives a different run");
+}
+
+/**
+*   Returns the chi-square value a statistic with dof degrees of freedom
+*   stays under but for one time in a thousand (Wilson-Hilferty).
+*/
+static double chi_square_limit(int dof)
+{
+    double k = 2.0 / (9.0 * dof);
+    return dof * pow(1 - k + CHI_SQUARE_Z * sqrt(k), 3);
+}
+
+static double chi_square(const uint32_t * counts, int cells, double expected)
+{
+    double sum = 0;
+    for(int i=0; i<cells; i++)
+        sum += (counts[i] - expected) * (counts[i] - expected) / expected;
+    return sum;
+}
+
+/**
+*   Returns the index of an ordering of 0 to length-1 among all of them.
+*/
+static int ordering_index(const uint8_t * array, uint8_t length)
+{
+    int index = 0;
+    for(uint8_t i=0; i<length; i++)
+    {
+        int smaller = 0;
+        for(uint8_t j=i+1; j<length; j++)
+            smaller += array[j] < array[i];
+        index = index * (length - i) + smaller;
+    }
+    return index;
+}
+
+static void check_orderings(uint8_t length, int orderings)
+{
+    static uint32_t counts[24];
+    uint8_t array[4];
+    char what[80];
+
+    long trials = PRNG_PERIOD / (length - 1);
+
+    memset(counts, 0, sizeof(counts));
+    prng_seed(0x5EED);
+    for(long trial=0; trial<trials; trial++)
+    {
+        for(uint8_t i=0; i<length; i++)
+            array[i] = i;
+        prng_shuffle(PRNG_WAVE, array, length);
+        counts[ordering_index(array, length)]++;
+    }
+    double value = chi_square(counts, orderings, (double)trials / orderings);
+    double limit = chi_square_limit(orderings - 1);
+    snprintf(what, sizeof(what), "%d orderings of %u: chi-square %.1f < %.1f", orderings, length, value, limit);
+    expect(value < limit, what);
+}
+
+static void check_positions(uint8_t length)
+{
+    static uint32_t counts[SHUFFLE_MAX * SHUFFLE_MAX];
+    uint8_t array[SHUFFLE_MAX];
+    long trials = PRNG_PERIOD / (length - 1);
+    char what[80];
+
+    memset(counts, 0, sizeof(counts));
+    prng_seed(0x5EED);
+    for(long trial=0; trial<trials; trial++)
+    {
+        for(uint8_t i=0; i<length; i++)
+            array[i] = i;
+        prng_shuffle(PRNG_WAVE, array, length);
+        for(uint8_t i=0; i<length; i++)
+            counts[array[i] * length + i]++;
+    }
+    double value = chi_square(counts, length * length, (double)trials / length);
+    double limit = chi_square_limit((length - 1) * (length - 1));
+    snprintf(what, sizeof(what), "positions of %u: chi-square %.1f < %.1f", length, value, limit);
+    expect(value < limit, what);
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void time_calls(void)
+{
+    volatile uint16_t sink = 0;
+    prng_seed(0x5EED);
+
+    double start = seconds();
+    for(long i=0; i<TIMED_CALLS; i++)
+        sink += prng_next(PRNG_MISC);
+    double next = (seconds() - start) * 1e9 / TIMED_CALLS;
+
+    start = seconds();
+    for(long i=0; i<TIMED_CALLS; i++)
+        sink += prng_range(PRNG_MISC, 84);
+    double range = (seconds() - start) * 1e9 / TIMED_CALLS;
+
+    printf("host time per call: prng_next %.2f ns, prng_range(84) %.2f ns\n", next, range);
+
+    static const uint8_t lengths[] = { 3, 16, 64 };
+    uint8_t array[SHUFFLE_MAX];
+    for(unsigned i=0; i<sizeof(lengths); i++)
+    {
+        long calls = TIMED_CALLS / lengths[i];
+        start = seconds();
+        for(long j=0; j<calls; j++)
+            prng_shuffle(PRNG_WAVE, array, lengths[i]);
+        printf("host time per prng_shuffle of %u: %.1f ns\n", lengths[i],
+               (seconds() - start) * 1e9 / calls);
+    }
+}
+
+int main(void)
+{
+    static const uint8_t sizes[] = { 2, 3, 7, 10, 64, 84, 200, 255 };
+    for(unsigned i=0; i<sizeof(sizes); i++)
+        check_range(sizes[i]);
+    check_replay();
+    check_orderings(3, 6);
+    check_orderings(4, 24);
+    check_positions(16);
+    check_positions(64);
+    time_calls();
+    return failures != 0;
+}
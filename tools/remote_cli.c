@@ -0,0 +1,691 @@
+/*
+*   Host side command line tool for the remote control protocol (remote.h).
+*
+*   Build:  cc -O2 -o remote_cli remote_cli.c
+*   Usage:  remote_cli <device> ping [count]
+*           remote_cli <device> set <param> <value> [<param> <value> ...]
+*           remote_cli <device> get <param> [<param> ...]
+*           remote_cli <device> place <asteroid|boulder|fragment|ship> <index> <x> <y>
+*           remote_cli <device> restart
+*           remote_cli <device> snapshot-save <file> [eeprom]
+*           remote_cli <device> snapshot-load <file|eeprom>
+*           remote_cli <device> throughput <seconds> [chunks per frame]
+*           remote_cli standin
+*
+*   Parameters are score, lives, speed, turret, ship_x, paused, seed, wave and
+*   stream_fps. Every command waits for its reply, ping also prints the round
+*   trip times. snapshot-save captures the game into the Teensy's RAM
+*   snapshot and copies the blob to a file, with "eeprom" it also has the
+*   Teensy keep it in EEPROM and waits while that is written in the
+*   background. snapshot-load sends a blob back and loads it, or with
+*   "eeprom" loads the one kept in EEPROM. A saved blob can be replayed in
+*   the benchmarks with "make bench BENCH_SNAPSHOT=<file>".
+*   To replay a game take its seed from "get seed" or the 's' status, then
+*   "set seed <seed>" and "restart" play it again with the same rocks.
+*
+*   throughput runs the USB throughput test (throughput.h). Every chunk is
+*   checked against the pattern and timestamped as it arrives. At the end
+*   it prints what the host saw next to the Teensy's own counts and the game
+*   frame rate during the test. The Teensy keeps its other serial output
+*   back while the test runs and refuses to start one while the screen
+*   stream is on ("set stream_fps 0" first). standin opens a pty that
+*   answers ping and the throughput test like a Teensy would, for trying
+*   the receiver out with no hardware: run it, then "remote_cli <the pty it
+*   prints> throughput 5". The rates it gives are the pty's and say nothing
+*   about USB; no figures have been taken on a Teensy yet.
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include <time.h>
+#include "../remote.h"
+#include "../throughput.h"
+
+// Object ids used by REMOTE_PLACE, these are the object widths in main.c.
+#define ASTEROID 0x07
+#define BOULDER 0x05
+#define FRAGMENT 0x03
+#define SHIP 0x09
+
+// Commands reply from the next frame, the slack is for replies queued
+// behind the throughput test. Copying a snapshot to EEPROM takes seconds
+// but runs in the background and is polled for every SNAPSHOT_STORE_POLL_MS.
+#define REPLY_TIMEOUT_MS 3000
+#define SNAPSHOT_STORE_POLL_MS 250
+
+static const char * param_names[PARAM_COUNT] =
+{
+    "score", "lives", "speed", "turret", "ship_x", "paused", "seed", "wave", "stream_fps"
+};
+
+static const char * status_names[] =
+{
+    "ok", "bad crc", "bad frame", "bad opcode", "bad payload", "busy"
+};
+
+// Timer0 ticks a second on the Teensy.
+#define TICKS_PER_SECOND (8000000.0 / (64.0 * 256.0))
+
+// How long the throughput test may go without a chunk before giving up.
+#define STREAM_TIMEOUT_MS 5000
+
+static uint8_t sequence = 0;
+
+/**
+*   Same CRC-8 as remote_crc8 on the Teensy.
+*/
+static uint8_t crc8(const uint8_t * bytes, int length)
+{
+    uint8_t crc = 0;
+    while(length--)
+    {
+        crc ^= *bytes++;
+        for(int i=0; i<8; i++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+static int cobs_encode(const uint8_t * in, int length, uint8_t * out)
+{
+    int code_at = 0, n = 1;
+    uint8_t code = 1;
+    for(int i=0; i<length; i++)
+    {
+        if(in[i] == 0)
+        {
+            out[code_at] = code;
+            code_at = n++;
+            code = 1;
+        }
+        else
+        {
+            out[n++] = in[i];
+            if(++code == 0xFF)
+            {
+                out[code_at] = code;
+                code_at = n++;
+                code = 1;
+            }
+        }
+    }
+    out[code_at] = code;
+    return n;
+}
+
+/**
+*   Returns the decoded length, or -1 if the frame is not valid COBS.
+*/
+static int cobs_decode(const uint8_t * in, int length, uint8_t * out)
+{
+    int n = 0, i = 0;
+    while(i < length)
+    {
+        uint8_t code = in[i++];
+        if(code == 0 || i + code - 1 > length)
+            return -1;
+        for(int j=1; j<code; j++)
+            out[n++] = in[i++];
+        if(code != 0xFF && i < length)
+            out[n++] = 0;
+    }
+    return n;
+}
+
+static double now_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000.0 + t.tv_nsec / 1e6;
+}
+
+static int open_device(const char * path)
+{
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if(fd < 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    struct termios tio;
+    if(tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+/**
+*   Function for adding the crc to a frame and sending it, the frame must
+*   have room for the crc.
+*/
+static void send_frame(int fd, uint8_t * frame, int length)
+{
+    uint8_t encoded[REMOTE_FRAME_MAX+4];
+    int n = 0;
+
+    frame[length] = crc8(frame, length);
+    encoded[n++] = 0;
+    n += cobs_encode(frame, length+1, &encoded[n]);
+    encoded[n++] = 0;
+    if(write(fd, encoded, n) != n)
+    {
+        perror("write");
+        exit(1);
+    }
+}
+
+/**
+*   Function for sending a command and waiting for the reply with the same
+*   sequence number, anything else on the port (console text, the screen
+*   stream) is skipped.
+*
+*   Returns: The reply status, or -1 on timeout. The reply payload is copied
+*            to reply and its length to reply_length.
+*/
+static int transact(int fd, uint8_t opcode, const uint8_t * payload, int length,
+                    uint8_t * reply, int * reply_length)
+{
+    uint8_t frame[REMOTE_FRAME_MAX];
+
+    if(length > REMOTE_FRAME_MAX - REMOTE_HEADER_SIZE - 1)
+    {
+        fprintf(stderr, "payload too long\n");
+        exit(1);
+    }
+    uint8_t seq = sequence++;
+    frame[0] = opcode;
+    frame[1] = seq;
+    memcpy(&frame[2], payload, length);
+    send_frame(fd, frame, length + REMOTE_HEADER_SIZE);
+
+    // Collect bytes between delimiters until the matching reply turns up
+    uint8_t in[256];
+    int in_length = -1;
+    double deadline = now_ms() + REPLY_TIMEOUT_MS;
+    while(now_ms() < deadline)
+    {
+        struct pollfd p = { fd, POLLIN, 0 };
+        if(poll(&p, 1, 10) <= 0)
+            continue;
+        uint8_t byte;
+        if(read(fd, &byte, 1) != 1)
+            continue;
+        if(byte != 0)
+        {
+            if(in_length >= 0 && in_length < (int)sizeof(in))
+                in[in_length++] = byte;
+            continue;
+        }
+        if(in_length > 0)
+        {
+            uint8_t decoded[256];
+            int d = cobs_decode(in, in_length, decoded);
+            if(d >= 4 && crc8(decoded, d-1) == decoded[d-1]
+               && decoded[0] == (opcode | REMOTE_REPLY) && decoded[1] == seq)
+            {
+                *reply_length = d - 4;
+                memcpy(reply, &decoded[3], d - 4);
+                return decoded[2];
+            }
+        }
+        in_length = 0;
+    }
+    return -1;
+}
+
+static int param_id(const char * name)
+{
+    for(int i=0; i<PARAM_COUNT; i++)
+    {
+        if(strcasecmp(name, param_names[i]) == 0)
+            return i;
+    }
+    fprintf(stderr, "unknown parameter %s\n", name);
+    exit(1);
+}
+
+static int object_id(const char * name)
+{
+    if(strcasecmp(name, "asteroid") == 0) return ASTEROID;
+    if(strcasecmp(name, "boulder") == 0) return BOULDER;
+    if(strcasecmp(name, "fragment") == 0) return FRAGMENT;
+    if(strcasecmp(name, "ship") == 0) return SHIP;
+    fprintf(stderr, "unknown object %s\n", name);
+    exit(1);
+}
+
+static int report(int status)
+{
+    if(status < 0)
+    {
+        fprintf(stderr, "no reply\n");
+        return 1;
+    }
+    if(status != REMOTE_OK)
+    {
+        fprintf(stderr, "error: %s\n", status <= REMOTE_BUSY ? status_names[status] : "unknown");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+*   Returns non zero if a chunk matches the pattern for its own header.
+*/
+static int chunk_valid(const uint8_t * chunk)
+{
+    uint8_t expected[THROUGHPUT_CHUNK_SIZE];
+    if(chunk[0] != THROUGHPUT_MAGIC || (chunk[1] & ~THROUGHPUT_LAST))
+        return 0;
+    throughput_fill(expected, chunk[1], chunk[2] | (chunk[3] << 8), chunk[4] | (chunk[5] << 8));
+    return memcmp(chunk, expected, THROUGHPUT_CHUNK_SIZE) == 0;
+}
+
+static uint16_t get_u16(const uint8_t * bytes)
+{
+    return bytes[0] | (bytes[1] << 8);
+}
+
+/**
+*   Function for running the throughput test and printing what both ends
+*   measured.
+*
+*   Returns: 0 if every chunk arrived intact and the Teensy never timed out.
+*/
+static int throughput(int fd, int seconds, int chunks_per_frame)
+{
+    uint8_t payload[2] = { seconds, chunks_per_frame };
+    uint8_t reply[256];
+    int reply_length = 0;
+    int status = transact(fd, REMOTE_THROUGHPUT, payload, 2, reply, &reply_length);
+    if(status == REMOTE_BUSY)
+        fprintf(stderr, "a test is already running or the screen stream is on\n");
+    if(report(status))
+        return 1;
+
+    static uint8_t buffer[65536];
+    int have = 0, done = 0;
+    long received = 0, lost = 0, skipped = 0;
+    uint16_t expected = 0;
+    double first = 0, last = 0, max_gap = 0, max_lag = 0;
+    double deadline = now_ms() + STREAM_TIMEOUT_MS;
+
+    while(!done && now_ms() < deadline)
+    {
+        struct pollfd p = { fd, POLLIN, 0 };
+        if(poll(&p, 1, 10) <= 0)
+            continue;
+        int n = read(fd, &buffer[have], sizeof(buffer) - have);
+        if(n <= 0)
+            continue;
+        have += n;
+        double at = now_ms();
+
+        // Slide along a byte at a time until a chunk lines up, anything in
+        // between is other serial output.
+        int i = 0;
+        while(!done && have - i >= THROUGHPUT_CHUNK_SIZE)
+        {
+            const uint8_t * chunk = &buffer[i];
+            if(!chunk_valid(chunk))
+            {
+                i++;
+                skipped++;
+                continue;
+            }
+            uint16_t sequence = get_u16(&chunk[2]);
+            double sent = get_u16(&chunk[4]) * 1000.0 / TICKS_PER_SECOND;
+            lost += (uint16_t)(sequence - expected);
+            expected = sequence + 1;
+            if(received == 0)
+                first = at;
+            else if(at - last > max_gap)
+                max_gap = at - last;
+            // How far arrival has fallen behind the Teensy's clock since the
+            // first chunk, the data buffered on the way.
+            if(at - first - sent > max_lag)
+                max_lag = at - first - sent;
+            last = at;
+            received++;
+            deadline = at + STREAM_TIMEOUT_MS;
+            done = chunk[1] & THROUGHPUT_LAST;
+            i += THROUGHPUT_CHUNK_SIZE;
+        }
+        memmove(buffer, &buffer[i], have - i);
+        have -= i;
+    }
+
+    double span = (last - first) / 1000;
+    printf("host:   %ld chunks, %ld lost, %ld bytes skipped, %.1f kB/s over %.2f s, "
+           "max gap %.1f ms, max lag %.1f ms%s\n",
+           received, lost, skipped, span > 0 ? received * THROUGHPUT_CHUNK_SIZE / span / 1000 : 0,
+           span, max_gap, max_lag, done ? "" : ", no last chunk");
+
+    // Ask for the counts, the Teensy is busy until it has sent the last chunk.
+    for(int tries=0; tries<20; tries++)
+    {
+        status = transact(fd, REMOTE_THROUGHPUT_RESULT, payload, 0, reply, &reply_length);
+        if(status != REMOTE_BUSY)
+            break;
+        usleep(250000);
+    }
+    if(report(status) || reply_length != THROUGHPUT_RESULT_SIZE)
+        return 1;
+
+    uint32_t bytes = reply[0] | (reply[1] << 8) | (reply[2] << 16) | ((uint32_t)reply[3] << 24);
+    uint16_t sent = get_u16(&reply[4]), stalls = get_u16(&reply[6]), timeouts = get_u16(&reply[8]);
+    uint16_t flushes = get_u16(&reply[10]), frames = get_u16(&reply[12]), ticks = get_u16(&reply[14]);
+    double seconds_taken = ticks / TICKS_PER_SECOND;
+    printf("teensy: %u bytes in %u chunks, %u stalls, %u timeouts, %u flushes, "
+           "%.1f kB/s, %.1f fps over %.2f s\n",
+           bytes, sent, stalls, timeouts, flushes,
+           seconds_taken > 0 ? bytes / seconds_taken / 1000 : 0,
+           seconds_taken > 0 ? frames / seconds_taken : 0, seconds_taken);
+
+    return !done || lost || skipped || timeouts;
+}
+
+// Frame rate of the game the stand-in pretends to be running.
+#define STANDIN_FPS 30
+
+/**
+*   Function for playing the Teensy's side of ping and the throughput test
+*   on a pty until killed. A chunk that cannot be written straight away is a
+*   stall, and one still stuck after 25ms is a timeout and dropped, like
+*   usb_serial_write.
+*/
+static int standin(void)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(fd < 0 || grantpt(fd) || unlockpt(fd))
+    {
+        perror("pty");
+        return 1;
+    }
+    struct termios tio;
+    if(tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    // Holding the other end open keeps reads working between clients.
+    const char * name = ptsname(fd);
+    int hold = open(name, O_RDWR | O_NOCTTY);
+    printf("stand-in on %s, its rates are the pty's and not a Teensy's\n", name);
+    fflush(stdout);
+
+    uint8_t in[256], decoded[256], frame[REMOTE_FRAME_MAX], chunk[THROUGHPUT_CHUNK_SIZE];
+    int in_length = -1;
+    int running = 0, seconds = 0, chunks_per_frame = 0;
+    double start = 0, next_frame = 0;
+    uint32_t bytes = 0;
+    uint16_t sent = 0, stalls = 0, timeouts = 0, frames = 0, ticks = 0;
+
+    for(;;)
+    {
+        struct pollfd p = { fd, POLLIN, 0 };
+        uint8_t byte;
+        if(poll(&p, 1, 1) > 0 && read(fd, &byte, 1) == 1)
+        {
+            if(byte != 0)
+            {
+                if(in_length >= 0 && in_length < (int)sizeof(in))
+                    in[in_length++] = byte;
+            }
+            else
+            {
+                int d = in_length > 0 ? cobs_decode(in, in_length, decoded) : -1;
+                in_length = 0;
+                if(d >= 3 && crc8(decoded, d-1) == decoded[d-1])
+                {
+                    uint8_t * payload = &decoded[REMOTE_HEADER_SIZE];
+                    int length = d - REMOTE_HEADER_SIZE - 1, reply_length = 0;
+                    uint8_t status = REMOTE_OK;
+                    frame[0] = decoded[0] | REMOTE_REPLY;
+                    frame[1] = decoded[1];
+                    if(decoded[0] == REMOTE_PING && length <= REMOTE_FRAME_MAX - 4)
+                    {
+                        memcpy(&frame[3], payload, length);
+                        reply_length = length;
+                    }
+                    else if(decoded[0] == REMOTE_THROUGHPUT)
+                    {
+                        if(length != 2 || payload[0] == 0 || payload[0] > THROUGHPUT_SECONDS_MAX || payload[1] == 0)
+                            status = REMOTE_BAD_PAYLOAD;
+                        else
+                        {
+                            seconds = payload[0];
+                            chunks_per_frame = payload[1];
+                            bytes = sent = stalls = timeouts = frames = ticks = 0;
+                            start = next_frame = now_ms() + 1000.0 / STANDIN_FPS;
+                            running = 1;
+                        }
+                    }
+                    else if(decoded[0] == REMOTE_THROUGHPUT_RESULT)
+                    {
+                        uint16_t counts[] = { sent, stalls, timeouts, 0, frames, ticks };
+                        if(running)
+                            status = REMOTE_BUSY;
+                        for(int i=0; !running && i<4; i++)
+                            frame[3+i] = bytes >> (8*i);
+                        for(int i=0; !running && i<6; i++)
+                        {
+                            frame[7+2*i] = counts[i] & 0xFF;
+                            frame[8+2*i] = counts[i] >> 8;
+                        }
+                        reply_length = running ? 0 : THROUGHPUT_RESULT_SIZE;
+                    }
+                    else
+                        status = REMOTE_BAD_OPCODE;
+                    frame[2] = status;
+                    send_frame(fd, frame, 3 + reply_length);
+                }
+            }
+        }
+
+        if(!running || now_ms() < next_frame)
+            continue;
+        next_frame += 1000.0 / STANDIN_FPS;
+        frames++;
+        uint16_t tick = (now_ms() - start) * TICKS_PER_SECOND / 1000;
+        for(int i=0; i<chunks_per_frame; i++)
+        {
+            int last = tick >= seconds * TICKS_PER_SECOND && i == chunks_per_frame-1;
+            throughput_fill(chunk, last ? THROUGHPUT_LAST : 0, sent, tick);
+            struct pollfd out = { fd, POLLOUT, 0 };
+            if(poll(&out, 1, 0) <= 0)
+            {
+                stalls++;
+                if(poll(&out, 1, 25) <= 0)
+                    out.revents = 0;
+            }
+            if((out.revents & POLLOUT) && write(fd, chunk, sizeof(chunk)) == sizeof(chunk))
+                bytes += sizeof(chunk);
+            else
+                timeouts++;
+            sent++;
+            if(last)
+            {
+                ticks = tick;
+                running = 0;
+            }
+        }
+    }
+    close(hold);
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    if(argc == 2 && strcmp(argv[1], "standin") == 0)
+        return standin();
+    if(argc < 3)
+    {
+        fprintf(stderr, "usage: %s <device> ping|set|get|place|restart|throughput ...\n", argv[0]);
+        return 1;
+    }
+    int fd = open_device(argv[1]);
+    const char * command = argv[2];
+    uint8_t payload[REMOTE_FRAME_MAX];
+    uint8_t reply[256];
+    int length = 0, reply_length = 0;
+
+    if(strcmp(command, "ping") == 0)
+    {
+        int count = argc > 3 ? atoi(argv[3]) : 10;
+        double min = 1e9, max = 0, total = 0;
+        int lost = 0;
+        for(int i=0; i<count; i++)
+        {
+            payload[0] = i;
+            double start = now_ms();
+            int status = transact(fd, REMOTE_PING, payload, 1, reply, &reply_length);
+            double rtt = now_ms() - start;
+            if(status != REMOTE_OK || reply_length != 1 || reply[0] != (uint8_t)i)
+            {
+                lost++;
+                continue;
+            }
+            total += rtt;
+            if(rtt < min) min = rtt;
+            if(rtt > max) max = rtt;
+        }
+        if(count - lost > 0)
+            printf("%d pings, %d lost, rtt min %.3f avg %.3f max %.3f ms\n",
+                   count, lost, min, total / (count - lost), max);
+        else
+            printf("%d pings, all lost\n", count);
+        return lost != 0;
+    }
+    if(strcmp(command, "set") == 0 && argc >= 5 && (argc - 3) % 2 == 0)
+    {
+        for(int i=3; i<argc; i+=2)
+        {
+            int value = atoi(argv[i+1]);
+            payload[length++] = param_id(argv[i]);
+            payload[length++] = value & 0xFF;
+            payload[length++] = (value >> 8) & 0xFF;
+        }
+        return report(transact(fd, REMOTE_SET, payload, length, reply, &reply_length));
+    }
+    if(strcmp(command, "get") == 0 && argc >= 4)
+    {
+        for(int i=3; i<argc; i++)
+            payload[length++] = param_id(argv[i]);
+        int status = transact(fd, REMOTE_GET, payload, length, reply, &reply_length);
+        if(report(status))
+            return 1;
+        for(int i=0; i<length && 2*i+1 < reply_length; i++)
+        {
+            // The seed uses all 16 bits, everything else is signed.
+            uint16_t value = reply[2*i] | (reply[2*i+1] << 8);
+            if(payload[i] == PARAM_SEED)
+                printf("%s = %u\n", argv[i+3], value);
+            else
+                printf("%s = %d\n", argv[i+3], (int16_t)value);
+        }
+        return 0;
+    }
+    if(strcmp(command, "place") == 0 && argc == 7)
+    {
+        payload[length++] = object_id(argv[3]);
+        payload[length++] = atoi(argv[4]);
+        payload[length++] = atoi(argv[5]);
+        payload[length++] = atoi(argv[6]);
+        return report(transact(fd, REMOTE_PLACE, payload, length, reply, &reply_length));
+    }
+    if(strcmp(command, "restart") == 0)
+    {
+        return report(transact(fd, REMOTE_RESTART, payload, 0, reply, &reply_length));
+    }
+    if(strcmp(command, "snapshot-save") == 0 && (argc == 4 || (argc == 5 && strcmp(argv[4], "eeprom") == 0)))
+    {
+        if(report(transact(fd, REMOTE_SNAPSHOT_SAVE, payload, 0, reply, &reply_length)) || reply_length != 2)
+            return 1;
+        int size = reply[0] | (reply[1] << 8);
+        FILE * out = fopen(argv[3], "wb");
+        if(!out)
+        {
+            perror(argv[3]);
+            return 1;
+        }
+        for(int offset=0; offset<size; offset+=REMOTE_SNAPSHOT_CHUNK)
+        {
+            int count = size - offset < REMOTE_SNAPSHOT_CHUNK ? size - offset : REMOTE_SNAPSHOT_CHUNK;
+            uint8_t request[3] = { offset & 0xFF, offset >> 8, count };
+            if(report(transact(fd, REMOTE_SNAPSHOT_READ, request, 3, reply, &reply_length)) || reply_length != count)
+                return 1;
+            fwrite(reply, 1, count, out);
+        }
+        fclose(out);
+        printf("snapshot of %d bytes saved to %s\n", size, argv[3]);
+        if(argc == 5)
+        {
+            // The copy to EEPROM goes on in the background, a byte a frame.
+            payload[0] = 1;
+            if(report(transact(fd, REMOTE_SNAPSHOT_STORE, payload, 1, reply, &reply_length)) || reply_length != 2)
+                return 1;
+            int left = reply[0] | (reply[1] << 8);
+            while(left)
+            {
+                usleep(SNAPSHOT_STORE_POLL_MS * 1000);
+                if(report(transact(fd, REMOTE_SNAPSHOT_STORE, payload, 0, reply, &reply_length)) || reply_length != 2)
+                    return 1;
+                left = reply[0] | (reply[1] << 8);
+            }
+            printf("snapshot kept in EEPROM\n");
+        }
+        return 0;
+    }
+    if(strcmp(command, "snapshot-load") == 0 && argc == 4 && strcmp(argv[3], "eeprom") == 0)
+    {
+        if(report(transact(fd, REMOTE_SNAPSHOT_FETCH, payload, 0, reply, &reply_length)) || reply_length != 2)
+            return 1;
+        if(report(transact(fd, REMOTE_SNAPSHOT_LOAD, payload, 0, reply, &reply_length)))
+            return 1;
+        printf("snapshot of %d bytes loaded from EEPROM\n", reply[0] | (reply[1] << 8));
+        return 0;
+    }
+    if(strcmp(command, "snapshot-load") == 0 && argc == 4)
+    {
+        uint8_t blob[1024];
+        FILE * in = fopen(argv[3], "rb");
+        if(!in)
+        {
+            perror(argv[3]);
+            return 1;
+        }
+        int size = fread(blob, 1, sizeof(blob), in);
+        fclose(in);
+        for(int offset=0; offset<size; offset+=REMOTE_SNAPSHOT_CHUNK)
+        {
+            int count = size - offset < REMOTE_SNAPSHOT_CHUNK ? size - offset : REMOTE_SNAPSHOT_CHUNK;
+            payload[0] = offset & 0xFF;
+            payload[1] = offset >> 8;
+            memcpy(&payload[2], &blob[offset], count);
+            if(report(transact(fd, REMOTE_SNAPSHOT_WRITE, payload, count + 2, reply, &reply_length)))
+                return 1;
+        }
+        if(report(transact(fd, REMOTE_SNAPSHOT_LOAD, payload, 0, reply, &reply_length)))
+            return 1;
+        printf("snapshot of %d bytes loaded\n", size);
+        return 0;
+    }
+    if(strcmp(command, "throughput") == 0 && (argc == 4 || argc == 5))
+    {
+        return throughput(fd, atoi(argv[3]), argc == 5 ? atoi(argv[4]) : 4);
+    }
+    fprintf(stderr, "bad command, see the top of remote_cli.c\n");
+    return 1;
+}
@@ -0,0 +1,216 @@
+/*
+*   Host test of the snapshot module (snapshot.h), run by "make host-test".
+*
+*   Build:  cc -O2 -Ihost -o snapshot_test snapshot_test.c host/avr_io.c
+*   Usage:  snapshot_test
+*
+*   Saves a set of fields, checks them and loads them back, then moves the
+*   blob out and back in the way the remote protocol does. The EEPROM copy
+*   is run against a stand-in EEPROM that stays busy for a while after each
+*   byte: it must never write while busy, must leave a snapshot that
+*   snapshot_fetch gives back, and a copy cut short at any byte (as by a
+*   reset) must never be taken for a snapshot. snapshot.c is included here
+*   so the test can cut the copy short.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "../snapshot.c"
+
+#define LAYOUT 0x031E
+#define CHUNK 32
+
+// Polls of eeprom_is_ready a byte write keeps the stand-in busy for.
+#define WRITE_POLLS 3
+
+static int failures = 0;
+
+static void expect(int ok, const char * what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    failures += !ok;
+}
+
+typedef struct
+{
+    uint8_t u8;
+    uint16_t u16;
+    int count;
+    double position;
+    double velocity;
+    double time;
+} fields_t;
+
+static const fields_t saved_a = { 200, 0xBEEF, -1234, -12.25, 0.7071, 1234.5678 };
+static const fields_t saved_b = { 7, 1, 99, 40.5, -1.5, 2.0 };
+
+/**
+*   Function for walking the fields in either direction, like snapshot_game.
+*/
+static uint16_t pass(uint8_t mode, fields_t * fields)
+{
+    snapshot_begin(mode);
+    snapshot_u8(&fields->u8);
+    snapshot_u16(&fields->u16);
+    snapshot_int(&fields->count);
+    snapshot_q16(&fields->position, 8);
+    snapshot_q16(&fields->velocity, 12);
+    snapshot_q32(&fields->time);
+    return snapshot_end(LAYOUT);
+}
+
+static uint16_t save(const fields_t * fields)
+{
+    fields_t copy = *fields;
+    return pass(SNAPSHOT_SAVE, &copy);
+}
+
+/**
+*   Returns non zero if the buffer loads back as the fields, the doubles to
+*   within half a step of their fixed point.
+*/
+static int loads_as(const fields_t * fields)
+{
+    fields_t loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    if(!snapshot_check(LAYOUT) || !pass(SNAPSHOT_LOAD, &loaded))
+        return 0;
+    return loaded.u8 == fields->u8 && loaded.u16 == fields->u16 && loaded.count == fields->count
+           && fabs(loaded.position - fields->position) <= 0.5/256
+           && fabs(loaded.velocity - fields->velocity) <= 0.5/4096
+           && fabs(loaded.time - fields->time) <= 0.5/65536;
+}
+
+static void check_round_trip(void)
+{
+    char what[80];
+    uint16_t length = save(&saved_a);
+    snprintf(what, sizeof(what), "save gives %u bytes, header and 13 of fields", length);
+    expect(length == SNAPSHOT_HEADER_SIZE + 13, what);
+    expect(snapshot_check(LAYOUT) == length, "the saved blob checks out");
+    expect(loads_as(&saved_a), "it loads back the same values");
+
+    expect(snapshot_check(LAYOUT + 1) == 0, "another layout is refused");
+    snapshot_buffer[SNAPSHOT_HEADER_SIZE + 3] ^= 0x10;
+    expect(snapshot_check(LAYOUT) == 0, "a flipped bit fails the crc");
+    snapshot_buffer[SNAPSHOT_HEADER_SIZE + 3] ^= 0x10;
+
+    uint8_t byte = 0;
+    snapshot_begin(SNAPSHOT_SAVE);
+    for(int i=0; i<SNAPSHOT_SIZE_MAX; i++)
+        snapshot_u8(&byte);
+    expect(snapshot_end(LAYOUT) == 0, "more than SNAPSHOT_SIZE_MAX does not save");
+}
+
+/**
+*   Function for moving the blob out and back in through snapshot_read and
+*   snapshot_write in chunks, as remote_cli's snapshot-save and -load do.
+*/
+static void check_transfer(void)
+{
+    static uint8_t host[SNAPSHOT_SIZE_MAX];
+    uint16_t length = save(&saved_a);
+    int complete = 1;
+    for(uint16_t offset=0; offset<length; offset+=CHUNK)
+    {
+        uint8_t count = length - offset < CHUNK ? length - offset : CHUNK;
+        complete &= snapshot_read(offset, &host[offset], count) == count;
+    }
+
+    save(&saved_b);
+    for(uint16_t offset=0; offset<length; offset+=CHUNK)
+    {
+        uint8_t count = length - offset < CHUNK ? length - offset : CHUNK;
+        complete &= snapshot_write(offset, &host[offset], count) == count;
+    }
+    expect(complete && loads_as(&saved_a), "read out in chunks and written back, it loads");
+    expect(snapshot_read(SNAPSHOT_SIZE_MAX - 1, host, CHUNK) == 1, "reads stop at the end of the buffer");
+}
+
+/**
+*   Function for running the EEPROM copy to the end.
+*
+*   Returns: The number of polls it took.
+*/
+static long store(void)
+{
+    long polls = 0;
+    snapshot_store_start();
+    while(snapshot_store_left() && polls < 100000)
+    {
+        snapshot_store_poll();
+        polls++;
+    }
+    return polls;
+}
+
+static void check_store(void)
+{
+    char what[80];
+    host_eeprom_write_polls = WRITE_POLLS;
+
+    uint16_t length = save(&saved_a);
+    host_eeprom_writes = host_eeprom_waits = 0;
+    long polls = store();
+    snprintf(what, sizeof(what), "EEPROM copy of %u bytes: %u writes over %ld polls", length, host_eeprom_writes, polls);
+    expect(memcmp(snapshot_store, snapshot_buffer, length) == 0 && polls > host_eeprom_writes, what);
+    expect(host_eeprom_waits == 0, "the copy never writes while the EEPROM is busy");
+
+    length = save(&saved_b);
+    expect(snapshot_store_start() && snapshot_fetch() == 0, "no fetch while a copy is under way");
+    while(snapshot_store_left())
+        snapshot_store_poll();
+
+    memset(snapshot_buffer, 0, sizeof(snapshot_buffer));
+    expect(snapshot_fetch() == length && loads_as(&saved_b), "the EEPROM snapshot fetches back and loads");
+
+    memset(snapshot_buffer, 0, sizeof(snapshot_buffer));
+    expect(snapshot_store_start() == 0, "an empty buffer is not copied");
+}
+
+/**
+*   Function for cutting the copy of one snapshot over another short after
+*   every number of bytes, then fetching as the game would after a reset.
+*   Up to the first byte the old snapshot is still there, after it neither
+*   is until the copy is done.
+*/
+static void check_cut_short(void)
+{
+    host_eeprom_write_polls = 0;
+    save(&saved_b);
+    store();
+    uint16_t steps = save(&saved_a) + 1;
+
+    int old_kept = 0, never_half = 1;
+    for(uint16_t cut=0; cut<steps; cut++)
+    {
+        save(&saved_b);
+        store();
+
+        save(&saved_a);
+        snapshot_store_start();
+        while(snapshot_store_step < cut)
+            snapshot_store_poll();
+
+        // A reset forgets the copy and the RAM snapshot.
+        snapshot_store_step = snapshot_store_steps = 0;
+        memset(snapshot_buffer, 0, sizeof(snapshot_buffer));
+        uint16_t fetched = snapshot_fetch();
+        if(cut == 0)
+            old_kept = fetched && loads_as(&saved_b);
+        else
+            never_half &= fetched == 0;
+    }
+    expect(old_kept, "a copy cut before its first byte leaves the old one");
+    expect(never_half, "a copy cut at any later byte is never fetched");
+}
+
+int main(void)
+{
+    check_round_trip();
+    check_transfer();
+    check_store();
+    check_cut_short();
+    return failures != 0;
+}
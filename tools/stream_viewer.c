@@ -0,0 +1,243 @@
+/*
+*   Host side viewer for the screen stream (make SCREEN_STREAM=1).
+*
+*   Reads the serial output of the Teensy, rebuilds each streamed frame and
+*   writes it out as a PGM image, anything that is not a stream chunk (the
+*   normal serial console text) is passed through to stderr.
+*
+*   Build:  cc -O2 -o stream_viewer stream_viewer.c
+*   Usage:  stream_viewer /dev/ttyACM0 [output prefix] [scale]
+*
+*   Frames are written to <prefix>NNNNN.pgm (default "frame_") and the size of
+*   every frame on the wire is printed along with a running average. A serial
+*   device is put in raw mode first, a capture file is read as it is.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "../screen_stream.h"
+
+#define LCD_X 84
+#define LCD_Y 48
+#define BANKS (LCD_Y/8)
+#define INPUT_SIZE 4096
+
+static uint8_t screen[BANKS][LCD_X];
+static uint8_t position[BANKS];
+
+// Bytes read but not parsed yet are input[input_start..input_end).
+static uint8_t input[INPUT_SIZE];
+static int input_start=0, input_end=0;
+
+/**
+*   Function for writing the rebuilt screen as a binary PGM, lit pixels are
+*   drawn black like on the LCD.
+*/
+static void write_frame(const char * prefix, unsigned number, int scale)
+{
+    char name[256];
+    snprintf(name, sizeof(name), "%s%05u.pgm", prefix, number);
+    FILE * file = fopen(name, "wb");
+    if(!file)
+    {
+        perror(name);
+        return;
+    }
+    fprintf(file, "P5\n%d %d\n255\n", LCD_X*scale, LCD_Y*scale);
+    for(int y=0; y<LCD_Y*scale; y++)
+    {
+        for(int x=0; x<LCD_X*scale; x++)
+        {
+            int lit = (screen[y/scale/8][x/scale] >> ((y/scale) & 7)) & 1;
+            fputc(lit ? 0 : 255, file);
+        }
+    }
+    fclose(file);
+}
+
+/**
+*   Function for applying the RLE payload of a bank chunk to the screen.
+*
+*   Returns: 0 if the payload runs past the end of the bank.
+*/
+static int apply_chunk(uint8_t flags, const uint8_t * payload, int length)
+{
+    int bank = flags & STREAM_BANK_MASK;
+    if(bank >= BANKS)
+        return 0;
+    if(flags & STREAM_BANK_START)
+    {
+        position[bank] = 0;
+        if(flags & STREAM_KEY)
+            memset(screen[bank], 0, LCD_X);
+    }
+
+    int i = 0;
+    while(i < length)
+    {
+        uint8_t token = payload[i++];
+        int count = (token & 0x7F) + 1;
+        if(position[bank] + count > LCD_X)
+            return 0;
+        if(token & 0x80)
+        {
+            if(i >= length)
+                return 0;
+            for(int n=0; n<count; n++)
+                screen[bank][position[bank]++] ^= payload[i];
+            i++;
+        }
+        else
+        {
+            if(i + count > length)
+                return 0;
+            for(int n=0; n<count; n++)
+                screen[bank][position[bank]++] ^= payload[i++];
+        }
+    }
+    return 1;
+}
+
+/**
+*   Function for opening the serial device or capture file. A tty is put in
+*   raw mode so the line discipline does not turn CR into LF, eat ^S/^Q or
+*   echo bytes back; reads block until at least one byte has arrived.
+*/
+static int open_input(const char * path)
+{
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if(fd < 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    struct termios tio;
+    if(tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+/**
+*   Function for making sure count bytes are waiting from input_start on,
+*   reading more as needed.
+*
+*   Returns: 0 at the end of the input or on a read error.
+*/
+static int fill(int fd, int count)
+{
+    if(input_start + count > INPUT_SIZE)
+    {
+        memmove(input, &input[input_start], input_end - input_start);
+        input_end -= input_start;
+        input_start = 0;
+    }
+    while(input_end - input_start < count)
+    {
+        ssize_t got = read(fd, &input[input_end], INPUT_SIZE - input_end);
+        if(got < 0 && errno == EINTR)
+            continue;
+        if(got <= 0)
+            return 0;
+        input_end += got;
+    }
+    return 1;
+}
+
+int main(int argc, char ** argv)
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: %s <serial device or capture file> [prefix] [scale]\n", argv[0]);
+        return 1;
+    }
+    const char * prefix = argc > 2 ? argv[2] : "frame_";
+    int scale = argc > 3 ? atoi(argv[3]) : 1;
+    if(scale < 1)
+        scale = 1;
+
+    int fd = open_input(argv[1]);
+
+    unsigned frames = 0, bad = 0;
+    unsigned long total = 0;
+    int synced = 0;
+
+    while(fill(fd, 1))
+    {
+        if(input[input_start] != STREAM_MAGIC)
+        {
+            fputc(input[input_start++], stderr);
+            continue;
+        }
+
+        // Header, payload and checksum. A chunk that does not check out is
+        // dropped a byte at a time, scanning for the next magic from the
+        // byte after this one, as the magic may have been a byte of
+        // console text and a real chunk can start inside what looked like
+        // this one.
+        if(!fill(fd, STREAM_HEADER_SIZE))
+            break;
+        int length = input[input_start+3];
+        if(length > STREAM_PAYLOAD_MAX)
+        {
+            bad++;
+            synced = 0;
+            input_start++;
+            continue;
+        }
+        if(!fill(fd, STREAM_HEADER_SIZE+length+1))
+            break;
+
+        uint8_t * chunk = &input[input_start];
+        uint8_t sum = 0;
+        for(int i=0; i<STREAM_HEADER_SIZE+length; i++)
+            sum += chunk[i];
+        if(sum != chunk[STREAM_HEADER_SIZE+length])
+        {
+            bad++;
+            synced = 0;
+            input_start++;
+            continue;
+        }
+        input_start += STREAM_HEADER_SIZE+length+1;
+
+        uint8_t flags = chunk[2];
+        if((flags & STREAM_FRAME_END) && length >= 2)
+        {
+            unsigned bytes = chunk[4] | (chunk[5] << 8);
+            bytes += STREAM_HEADER_SIZE + length + 1;
+            if(synced)
+            {
+                total += bytes;
+                frames++;
+                write_frame(prefix, frames, scale);
+                printf("frame %u seq %u: %u bytes (average %lu, %u bad chunks)\n",
+                       frames, chunk[1], bytes, total/frames, bad);
+                fflush(stdout);
+            }
+        }
+        else
+        {
+            // Nothing is shown until a keyframe has been seen
+            if((flags & STREAM_KEY) && (flags & STREAM_BANK_START)
+               && (flags & STREAM_BANK_MASK) == 0)
+                synced = 1;
+            if(synced && !apply_chunk(flags, &chunk[STREAM_HEADER_SIZE], length))
+            {
+                bad++;
+                synced = 0;
+            }
+        }
+    }
+    close(fd);
+    return 0;
+}
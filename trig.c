@@ -0,0 +1,54 @@
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "trig.h"
+
+// First quarter of a sine wave in 64 steps, sin(i*pi/128) as Q1.14.
+#define TRIG_QUARTER_STEPS 64
+static const int16_t trig_quarter[TRIG_QUARTER_STEPS+1] PROGMEM =
+{
+    0, 402, 804, 1205, 1606, 2006, 2404, 2801,
+    3196, 3590, 3981, 4370, 4756, 5139, 5520, 5897,
+    6270, 6639, 7005, 7366, 7723, 8076, 8423, 8765,
+    9102, 9434, 9760, 10080, 10394, 10702, 11003, 11297,
+    11585, 11866, 12140, 12406, 12665, 12916, 13160, 13395,
+    13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978,
+    15137, 15286, 15426, 15557, 15679, 15791, 15893, 15986,
+    16069, 16143, 16207, 16261, 16305, 16340, 16364, 16379,
+    16384
+};
+
+/**
+*   Returns the sine of a binary angle as Q1.14.
+*
+*   Note: The table step is picked by the top 8 bits of the angle and the
+*         low 8 bits interpolate to the next step, the error is below 0.1%.
+*/
+int16_t trig_sin(uint16_t angle)
+{
+    uint8_t quadrant = angle >> 14;
+    uint8_t step = (angle >> 8) & (TRIG_QUARTER_STEPS-1);
+    uint8_t fraction = angle & 0xFF;
+    int16_t from, to;
+
+    // The second and fourth quarters run the table backwards.
+    if(quadrant & 1)
+    {
+        from = pgm_read_word(&trig_quarter[TRIG_QUARTER_STEPS-step]);
+        to = pgm_read_word(&trig_quarter[TRIG_QUARTER_STEPS-step-1]);
+    }
+    else
+    {
+        from = pgm_read_word(&trig_quarter[step]);
+        to = pgm_read_word(&trig_quarter[step+1]);
+    }
+    int16_t value = from + (int16_t)(((int32_t)(to - from) * fraction) >> 8);
+    return quadrant & 2 ? -value : value;
+}
+
+/**
+*   Returns the cosine of a binary angle as Q1.14.
+*/
+int16_t trig_cos(uint16_t angle)
+{
+    return trig_sin(angle + 0x4000);
+}
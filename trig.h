@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+// Fixed point trig for builds with FIXED_MATH. Angles are binary, a full
+// turn is 65536 so they wrap for free in a uint16_t, and results are Q1.14.
+#define TRIG_TURN 65536.0
+#define TRIG_ONE (1<<14)
+#define TRIG_ANGLE(radians) ((uint16_t)(int32_t)((radians) * (TRIG_TURN / (2*M_PI))))
+
+int16_t trig_sin(uint16_t angle);
+int16_t trig_cos(uint16_t angle);
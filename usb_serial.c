@@ -301,6 +301,11 @@ static volatile uint8_t usb_configuration=0;
 static volatile uint8_t transmit_flush_timer=0;
 static uint8_t transmit_previous_timeout=0;
 
+// number of times the flush timer or usb_serial_flush_output released the
+// FIFO, a partly filled or zero length packet.  Full packets are sent as
+// soon as they fill up and are not counted.
+volatile uint16_t usb_serial_flushes=0;
+
 // serial port settings (baud rate, control signals, etc) set
 // by the PC.  These are ignored, but kept in RAM.
 static uint8_t cdc_line_coding[7]={0x00, 0xE1, 0x00, 0x00, 0x00, 0x00, 0x08};
@@ -478,6 +483,26 @@ int8_t usb_serial_putchar_nowait(uint8_t c)
 	return 0;
 }
 
+// number of bytes that can be written to the transmit FIFO right now
+// without waiting, 0 if the current bank is busy or we're not online.
+// A write of up to this many bytes never blocks.
+uint8_t usb_serial_write_room(void)
+{
+	uint8_t intr_state, room;
+
+	if (!usb_configuration) return 0;
+	intr_state = SREG;
+	cli();
+	UENUM = CDC_TX_ENDPOINT;
+	if (UEINTX & (1<<RWAL)) {
+		room = CDC_TX_SIZE - UEBCLX;
+	} else {
+		room = 0;
+	}
+	SREG = intr_state;
+	return room;
+}
+
 // transmit a buffer.
 //  0 returned on success, -1 on error
 // This function is optimized for speed!  Each call takes approx 6.1 us overhead
@@ -635,6 +660,7 @@ void usb_serial_flush_output(void)
 		UENUM = CDC_TX_ENDPOINT;
 		UEINTX = 0x3A;
 		transmit_flush_timer = 0;
+		usb_serial_flushes++;
 	}
 	SREG = intr_state;
 }
@@ -739,6 +765,7 @@ ISR(USB_GEN_vect)
 				if (!t) {
 					UENUM = CDC_TX_ENDPOINT;
 					UEINTX = 0x3A;
+					usb_serial_flushes++;
 				}
 			}
 		}
@@ -16,7 +16,9 @@ void usb_serial_flush_input(void);	// discard any buffered input
 int8_t usb_serial_putchar(uint8_t c);	// transmit a character
 int8_t usb_serial_putchar_nowait(uint8_t c);  // transmit a character, do not wait
 int8_t usb_serial_write(const uint8_t *buffer, uint16_t size); // transmit a buffer
+uint8_t usb_serial_write_room(void);	// bytes writable without waiting
 void usb_serial_flush_output(void);	// immediately transmit any buffered output
+extern volatile uint16_t usb_serial_flushes; // short packets sent by flushes
 
 // serial parameters
 uint32_t usb_serial_get_baud(void);	// get the baud rate
@@ -0,0 +1,43 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <avr/pgmspace.h>
+#include "wave.h"
+
+// Precomputed spawn orders for scripted waves.
+static const uint8_t sweep_order[] PROGMEM = {0, 1, 2};
+static const uint8_t pincer_order[] PROGMEM = {0, 2, 1};
+
+// Difficulty curve, one entry per wave. Once the last wave is reached it is
+// repeated for the rest of the game. Counts larger than the asteroid pool
+// are clamped when loaded so the same table works with every pool size.
+static const wave_t wave_table[] PROGMEM =
+{
+    { 3, 1, 15, 10, sweep_order},
+    { 3, 1, 12, 10, pincer_order},
+    { 4, 1, 12, 11, NULL},
+    { 5, 1, 10, 12, NULL},
+    { 6, 1, 10, 13, NULL},
+    { 8, 1,  8, 14, NULL},
+    {12, 1,  6, 15, NULL},
+    {16, 1,  5, 16, NULL},
+    {24, 1,  4, 18, NULL},
+    {32, 1,  3, 20, NULL},
+    {48, 1,  2, 20, NULL},
+    {64, 1,  2, 22, NULL}
+};
+#define WAVE_COUNT (sizeof(wave_table)/sizeof(wave_t))
+
+/**
+*   Function for copying a wave table entry out of flash.
+*
+*   Parameters:
+*           number: The wave number, anything past the end of the table
+*                   loads the last entry.
+*           wave: A pointer to the wave to be filled in.
+*/
+void wave_load(uint8_t number, wave_t * wave)
+{
+    if(number >= WAVE_COUNT)
+        number = WAVE_COUNT-1;
+    memcpy_P(wave, &wave_table[number], sizeof(wave_t));
+}
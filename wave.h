@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+*   A single entry in the wave table.
+*
+*   asteroids: Number of asteroids spawned in the wave, clamped to the
+*              asteroid pool size.
+*   min_delay: Shortest delay between spawns in tenths of a second.
+*   max_delay: Longest delay between spawns in tenths of a second.
+*   speed: Fall speed multiplier in tenths, 10 is normal speed.
+*   order: Optional spawn order for waves known in advance, a PROGMEM
+*          array of asteroid slots at least asteroids long. When NULL the
+*          slots are shuffled.
+*/
+typedef struct
+{
+    uint8_t asteroids;
+    uint8_t min_delay;
+    uint8_t max_delay;
+    uint8_t speed;
+    const uint8_t * order;
+} wave_t;
+
+void wave_load(uint8_t number, wave_t * wave);